@@ -0,0 +1,92 @@
+// checks the doubly linked lists of list.h, which nothing in konoha uses yet.
+// run by `make test`
+#include "list.h"
+
+struct Elem;
+typedef struct Elem Elem;
+
+struct Elem {
+  int val;
+  INTRUSIVE_DLIST_HOOK(Elem);
+};
+
+DEFINE_INTRUSIVE_DLIST(Elem);
+USE_INTRUSIVE_DLIST(Elem);
+
+int failures = 0;
+
+// l has to hold exactly the values of expected, forward and backward
+void expect(INTRUSIVE_LIST_OF(Elem) l, int const* expected, int n, char const* what) {
+  bool ok = list_of_Elem_length(l) == n;
+  Elem* e = l->head;
+  Elem* prev = NULL;
+  for(int i = 0; ok && i < n; ++i) {
+    ok = e != NULL && e->val == expected[i] && e->_hook.prev == prev;
+    prev = e;
+    e = e->_hook.next;
+  }
+  ok = ok && e == NULL && l->tail == prev;
+  if(!ok) {
+    printf("list_test: %s failed\n", what);
+    ++failures;
+  }
+}
+
+int main() {
+  Elem elems[6];
+  for(int i = 0; i < 6; ++i) {
+    init_Elem_hook(&elems[i]);
+    elems[i].val = i;
+  }
+  INTRUSIVE_LIST_OF(Elem) l = new_list_of_Elem();
+  expect(l, NULL, 0, "new");
+
+  list_of_Elem_append(l, &elems[1]);
+  list_of_Elem_append(l, &elems[2]);
+  expect(l, (int[]){1, 2}, 2, "append");
+
+  list_of_Elem_push(l, &elems[0]);
+  expect(l, (int[]){0, 1, 2}, 3, "push");
+
+  list_of_Elem_insert_after(l, &elems[1], &elems[3]);
+  expect(l, (int[]){0, 1, 3, 2}, 4, "insert_after in the middle");
+  list_of_Elem_insert_after(l, &elems[2], &elems[4]);
+  expect(l, (int[]){0, 1, 3, 2, 4}, 5, "insert_after the tail");
+
+  list_of_Elem_remove(l, &elems[3]);
+  expect(l, (int[]){0, 1, 2, 4}, 4, "remove in the middle");
+  list_of_Elem_remove(l, &elems[0]);
+  expect(l, (int[]){1, 2, 4}, 3, "remove the head");
+  list_of_Elem_remove(l, &elems[4]);
+  expect(l, (int[]){1, 2}, 2, "remove the tail");
+  list_of_Elem_append(l, &elems[5]);
+  expect(l, (int[]){1, 2, 5}, 3, "append after removing the tail");
+
+  if(list_of_Elem_pop(l) != &elems[1]) {
+    printf("list_test: pop returned a wrong one\n");
+    ++failures;
+  }
+  expect(l, (int[]){2, 5}, 2, "pop");
+  if(elems[1]._hook.next != NULL || elems[1]._hook.prev != NULL) {
+    printf("list_test: pop left links in the popped one\n");
+    ++failures;
+  }
+  list_of_Elem_insert_after(l, &elems[2], &elems[1]);
+  expect(l, (int[]){2, 1, 5}, 3, "insert_after a popped one");
+  list_of_Elem_remove(l, &elems[1]);
+  expect(l, (int[]){2, 5}, 2, "remove a reinserted one");
+
+  list_of_Elem_remove(l, &elems[2]);
+  list_of_Elem_remove(l, &elems[5]);
+  expect(l, NULL, 0, "remove the last one");
+  list_of_Elem_append(l, &elems[0]);
+  expect(l, (int[]){0}, 1, "append to the emptied list");
+  if(list_of_Elem_pop(l) != &elems[0] || list_of_Elem_pop(l) != NULL) {
+    printf("list_test: pop of the last one failed\n");
+    ++failures;
+  }
+  expect(l, NULL, 0, "pop the last one");
+
+  free(l);
+  return failures != 0;
+}
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+
+size_t const ARENA_CHUNK_SIZE = 64 * 1024;
+size_t const ARENA_ALIGN = 16;
+
+struct ArenaChunk {
+  struct ArenaChunk* next;
+  size_t size;
+  size_t used;
+  _Alignas(16) char mem[];
+};
+
+struct Arena {
+  struct ArenaChunk* chunks; // newest first
+  size_t allocated;
+};
+
+Arena* new_Arena() {
+  Arena* const a = malloc(sizeof(Arena));
+  a->chunks = NULL;
+  a->allocated = 0;
+  return a;
+}
+
+struct ArenaChunk* new_ArenaChunk(size_t size) {
+  struct ArenaChunk* const c = malloc(sizeof(struct ArenaChunk) + size);
+  assert(c != NULL);
+  c->next = NULL;
+  c->size = size;
+  c->used = 0;
+  return c;
+}
+
+void* Arena_alloc(Arena* a, size_t size) {
+  assert(a != NULL);
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  a->allocated += size;
+#ifdef DEBUG
+  // one chunk per object, so memwatch sees each of them
+  struct ArenaChunk* const c = new_ArenaChunk(size);
+  c->used = size;
+  c->next = a->chunks;
+  a->chunks = c;
+  return c->mem;
+#else
+  struct ArenaChunk* c = a->chunks;
+  if(c == NULL || c->size - c->used < size) {
+    if(size > ARENA_CHUNK_SIZE / 4) {
+      // big object: give it its own chunk, keep bumping in the current one
+      struct ArenaChunk* const big = new_ArenaChunk(size);
+      big->used = size;
+      if(c == NULL) {
+        a->chunks = big;
+      } else {
+        big->next = c->next;
+        c->next = big;
+      }
+      return big->mem;
+    }
+    c = new_ArenaChunk(ARENA_CHUNK_SIZE);
+    c->next = a->chunks;
+    a->chunks = c;
+  }
+  void* const p = c->mem + c->used;
+  c->used += size;
+  return p;
+#endif
+}
+
+void release_Arena(Arena* a) {
+  assert(a != NULL);
+  struct ArenaChunk* c = a->chunks;
+  while(c != NULL) {
+    struct ArenaChunk* const next = c->next;
+    free(c);
+    c = next;
+  }
+  a->chunks = NULL;
+  a->allocated = 0;
+}
+
+size_t Arena_allocated(Arena const* a) {
+  return a->allocated;
+}
+
+Arena regions[NUMBER_OF_REGIONS];
+
+void* region_alloc(Region r, size_t size) {
+  assert(r < NUMBER_OF_REGIONS);
+  return Arena_alloc(&regions[r], size);
+}
+
+void release_region(Region r) {
+  assert(r < NUMBER_OF_REGIONS);
+  release_Arena(&regions[r]);
+}
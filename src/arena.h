@@ -0,0 +1,47 @@
+#ifndef NNA774_KONOHA_ARENA_H
+#define NNA774_KONOHA_ARENA_H
+
+#include <stddef.h>
+#include <string.h>
+#include "enum.h"
+#include "utils.h"
+
+// bump pointer allocator. objects are never freed one by one;
+// the whole arena is released at once.
+// with DEBUG, every object is a separate malloc so memwatch can check it.
+struct Arena;
+typedef struct Arena Arena;
+
+Arena* new_Arena();
+void* Arena_alloc(Arena*, size_t);
+void release_Arena(Arena*);
+size_t Arena_allocated(Arena const*);
+
+// compiler-lifetime regions, one arena for each phase
+ENUM_WITH_SHOW(
+  Region,
+  TOKEN_REGION,   // tokens(dropped after parsing)
+  AST_REGION,     // ast, env, vars, types and interned names
+  CODEGEN_REGION, // emitter scratch
+  NUMBER_OF_REGIONS,
+)
+
+void* region_alloc(Region, size_t);
+void release_region(Region);
+
+// makes room for one more element of the array ptr[count], doubling it when full
+#define GROW_ARRAY(Type, ptr, count, capacity, initial) \
+  do {\
+    if((count) == (capacity)) {\
+      /* the old array stays in CODEGEN_REGION until it's released */\
+      int const _capacity = (capacity) == 0 ? (initial) : (capacity) * 2;\
+      Type* const _array = region_alloc(CODEGEN_REGION, sizeof(Type) * _capacity);\
+      if((count) != 0) {\
+        memcpy(_array, (ptr), sizeof(Type) * (count));\
+      }\
+      (ptr) = _array;\
+      (capacity) = _capacity;\
+    }\
+  } while(0)
+
+#endif // NNA774_KONOHA_ARENA_H
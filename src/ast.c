@@ -4,34 +4,39 @@
 #include <assert.h>
 #include <string.h>
 
+#include "arena.h"
 #include "ast.h"
 #include "utils.h"
 
+// vars/types keep declaration order(for print_env),
+// var_map/type_map index the same objects by name for lookup.
 struct Env {
   Env* parent;
   INTRUSIVE_LIST_OF(Var) vars;
   INTRUSIVE_LIST_OF(Type) types;
+  SymbolMap* var_map;
+  SymbolMap* type_map;
 };
 
-Type* new_Type(char const* name, int size);
+Type* new_Type(Symbol name, int size);
 Ast* to_ast(AstType t, void*);
 Ast* parse_expr(Env* env, Tokens ts);
 Type* parse_type(Env* env, Tokens ts);
-Ast* parse_funcall(Env* env, Tokens ts, char const* name);
+Ast* parse_funcall(Env* env, Tokens ts, Symbol name);
 Ast* parse_block(Env* env, Tokens ts);
 Statement* parse_statement(Env* env, Tokens ts);
 char const* show_AstType(AstType);
-Var* find_var_by_name(Env* env, char const* name);
+Var* find_var_by_name(Env* env, Symbol name);
 int const MAX_ARGC = 6;
 
 Ast* new_Ast() {
-  Ast* ast = malloc(sizeof(Ast));
+  Ast* ast = region_alloc(AST_REGION, sizeof(Ast));
   init_Ast_hook(ast);
   return ast;
 }
 
 Ast** new_Ast_array(size_t size) {
-  Ast** const arr = malloc(sizeof(Ast*) * (size));
+  Ast** const arr = region_alloc(AST_REGION, sizeof(Ast*) * (size));
   for(size_t i = 0; i < size; ++i) {
     arr[i] = new_Ast();
   }
@@ -39,19 +44,23 @@ Ast** new_Ast_array(size_t size) {
 }
 
 Env* new_Env_impl(Env* env) {
-  Env* const e = malloc(sizeof(Env));
+  Env* const e = region_alloc(AST_REGION, sizeof(Env));
   e->parent = env;
   e->types = new_list_of_Type();
   e->vars = new_list_of_Var();
+  e->var_map = new_SymbolMap();
+  e->type_map = new_SymbolMap();
   return e;
 }
 
 Env* new_Env() {
   Env* const e = new_Env_impl(NULL);
-  Type* int_ = new_Type("int", 4);
-  Type* char_ = new_Type("char", 1);
+  Type* int_ = new_Type(intern_cstr("int"), 4);
+  Type* char_ = new_Type(intern_cstr("char"), 1);
   list_of_Type_append(e->types, int_);
+  SymbolMap_insert(e->type_map, int_->name, int_);
   list_of_Type_append(e->types, char_);
+  SymbolMap_insert(e->type_map, char_->name, char_);
   return e;
 }
 
@@ -59,68 +68,69 @@ Env* expand_Env(Env* parent) {
   return new_Env_impl(parent);
 }
 
-Var* new_Var(Type* t, char const* name) {
+Var* new_Var(Type* t, Symbol name) {
   assert(t != NULL);
-  Var* const v = malloc(sizeof(Var));
+  Var* const v = region_alloc(AST_REGION, sizeof(Var));
   v->name = name;
   v->type = t;
   v->initialized = false;
   v->defined = false;
-  v->offset = 0;
+  v->id = -1;
   init_Var_hook(v);
   return v;
 }
 
 FunCall* new_FunCall() {
-  FunCall* const f = malloc(sizeof(FunCall));
+  FunCall* const f = region_alloc(AST_REGION, sizeof(FunCall));
   f->name = NULL;
   f->argc = 0;
   f->args = NULL;
+  f->id = -1;
   return f;
 }
 
 Var* copy_var(Var const* _v) {
-  Var* const v = malloc(sizeof(Var));
+  Var* const v = region_alloc(AST_REGION, sizeof(Var));
   memcpy(v, _v, sizeof(Var));
   return v;
 }
 
 Statement* new_Statement() {
-  Statement* const s = malloc(sizeof(Statement));
+  Statement* const s = region_alloc(AST_REGION, sizeof(Statement));
   s->val = NULL;
   init_Statement_hook(s);
   return s;
 }
 
 Statements* new_Statements() {
-  Statements* const s = malloc(sizeof(Statements));
+  Statements* const s = region_alloc(AST_REGION, sizeof(Statements));
   s->val = NULL;
   return s;
 }
 
 Block* new_Block(Env* env) {
-  Block* const b = malloc(sizeof(Block));
+  Block* const b = region_alloc(AST_REGION, sizeof(Block));
   b->val = NULL;
   assert(env != NULL);
   b->env = env;
   return b;
 }
 
-Type* new_Type(char const* name, int size) {
+Type* new_Type(Symbol name, int size) {
   assert(name != NULL);
-  Type* const t = malloc(sizeof(Type));
+  Type* const t = region_alloc(AST_REGION, sizeof(Type));
   t->name = name;
   t->size = size;
   init_Type_hook(t);
   return t;
 }
 
-FunDef* new_FunDef(FunType type, char const* name, Var** args, Ast* body) {
+FunDef* new_FunDef(FunType type, Symbol name, Var** args, Ast* body) {
   assert(name != NULL);
   assert(args != NULL);
   assert(body != NULL);
   assert(body->type == AST_BLOCK);
-  FunDef* const t = malloc(sizeof(FunDef));
+  FunDef* const t = region_alloc(AST_REGION, sizeof(FunDef));
   t->type = type;
   t->name = name;
   t->args = args;
@@ -129,7 +139,7 @@ FunDef* new_FunDef(FunType type, char const* name, Var** args, Ast* body) {
 }
 
 Global* new_Global() {
-  Global* const g = malloc(sizeof(Global));
+  Global* const g = region_alloc(AST_REGION, sizeof(Global));
   g->list = new_list_of_Ast();
   return g;
 }
@@ -171,7 +181,7 @@ Ast* make_ast_symbol_ref(Env* env, Var* var) {
   return to_ast(AST_SYM, v);
 }
 
-Ast* make_ast_bi_op(TokenType const t, Ast const* lhs, Ast const* rhs) {
+Ast* make_ast_bi_op(TokenType const t, Ast* lhs, Ast* rhs) {
   Ast* const ast = new_Ast();
   ast->type = AST_BI_OP;
   ast->bi_op.lhs = lhs;
@@ -257,7 +267,7 @@ Ast* make_ast_block(Env* env, Ast* b) {
   return ast;
 }
 
-Ast* make_ast_funcall(char const* name, int argc, Ast** args) {
+Ast* make_ast_funcall(Symbol name, int argc, Ast** args) {
   Ast* const ast = new_Ast();
   ast->type = AST_FUNCALL;
   ast->funcall = new_FunCall();
@@ -275,32 +285,27 @@ Ast* make_global(INTRUSIVE_LIST_OF(Ast) asts) {
   return to_ast(AST_GLOBAL, asts);
 }
 
-Type* find_type_by_name(Env const* env, char const* name) {
-  assert(env->types != NULL);
-  FOREACH(Type, env->types, t) {
-    if(!strcmp(t->name, name)) {
+Type* find_type_by_name(Env const* env, Symbol name) {
+  for(; env != NULL; env = env->parent) {
+    Type* const t = SymbolMap_find(env->type_map, name);
+    if(t != NULL) {
       return t;
     }
   }
-  if(env->parent != NULL) {
-    return find_type_by_name(env->parent, name);
-  }
   return NULL;
 }
 
-Var* find_var_by_name(Env* env, char const* name) {
-  FOREACH(Var, env->vars, v) {
-    if(!strcmp(v->name, name)) {
+Var* find_var_by_name(Env* env, Symbol name) {
+  for(; env != NULL; env = env->parent) {
+    Var* const v = SymbolMap_find(env->var_map, name);
+    if(v != NULL) {
       return v;
     }
   }
-  if(env->parent != NULL) {
-    return find_var_by_name(env->parent, name);
-  }
   return NULL;
 }
 
-Var* add_sym_to_env(Env* env, Type* type, char const* sym_name) {
+Var* add_sym_to_env(Env* env, Type* type, Symbol sym_name) {
   assert(find_type_by_name(env, type->name) != NULL);
   if(find_var_by_name(env, sym_name)) {
     warn("identifier %s is already declared\n", sym_name);
@@ -308,21 +313,23 @@ Var* add_sym_to_env(Env* env, Type* type, char const* sym_name) {
 
   Var* const v = new_Var(type, sym_name);
   list_of_Var_append(env->vars, v);
-  v->offset = list_of_Var_length(env->vars) * 4;
+  if(SymbolMap_find(env->var_map, sym_name) == NULL) {
+    // on redeclaration, the first one keeps winning lookups
+    SymbolMap_insert(env->var_map, sym_name, v);
+  }
   return v;
 }
 
-Ast* make_ast_val_define(Env* env, Type* t, char const* sym_name) {
+Ast* make_ast_val_define(Env* env, Type* t, Symbol sym_name) {
   Var* v = add_sym_to_env(env, t, sym_name);
   return to_ast(AST_SYM_DEFINE, v);
 }
 
 Ast* parse_int(Token t, int sign) {
   assert(t.type == INTEGER_LITERAL_T);
-  String const s = t.string;
   int sum = 0;
-  int max = String_length(s);
-  char const* ss = c_str(s);
+  int const max = t.length;
+  char const* const ss = t.top;
   for(int i = 0; i < max; ++i) {
     sum  = sum * 10 + (ss[i] - '0');
   }
@@ -331,13 +338,13 @@ Ast* parse_int(Token t, int sign) {
 
 Ast* parse_char(Token t) {
   assert(t.type == CHARACTER_LITERAL_T);
-  return make_ast_int(head_char(t.string));
+  return make_ast_int(Token_head(t));
 }
 
 Ast* parse_symbol_or_funcall(Env* env, Tokens ts) {
-  char const* name = c_str(pop_Token(ts).string);
+  Symbol const name = pop_Token(ts).sym;
   Token const token = peek_Token(ts);
-  char const c = head_char(token.string);
+  char const c = Token_head(token);
   if(token.type == OPEN_PAREN_T && c == '(') {
     // funcall
     return parse_funcall(env, ts, name);
@@ -354,7 +361,7 @@ Ast* parse_symbol_or_funcall(Env* env, Tokens ts) {
 
 Ast* parse_prim(Env* env, Tokens ts) {
   Token const t = peek_Token(ts);
-  char const c = head_char(t.string);
+  char const c = Token_head(t);
   if(t.type == INTEGER_LITERAL_T) {
     pop_Token(ts);
     int const sign = 1;
@@ -368,10 +375,10 @@ Ast* parse_prim(Env* env, Tokens ts) {
     pop_Token(ts);
     Ast* const ast = parse_expr(env, ts);
     Token const t2 = pop_Token(ts);
-    char const c2 = head_char(t2.string);
+    char const c2 = Token_head(t2);
     if(t2.type != CLOSE_PAREN_T || c2 != ')') {
       if(t2.type == EOF_T) { warn("unterminated expr(got unexpeced EOF)\n"); }
-      else { warn("unterminated token(got %s)\n", c_str(t2.string)); }
+      else { warn("unterminated token(got %s)\n", Token_c_str(t2)); }
       return NULL;
     }
     return ast;
@@ -391,21 +398,21 @@ Ast* parse_prim(Env* env, Tokens ts) {
     return make_ast_bi_op(OP_MULTI_T, neg, subseq);
   } else {
     if(t.type == EOF_T) { warn("unexpected EOF\n"); }
-    else { warn("unknown token: %s\n", c_str(t.string)); }
+    else { warn("unknown token: %s\n", Token_c_str(t)); }
     return NULL;
   }
 }
 
-Ast* parse_funcall(Env* env, Tokens ts, char const* name) {
+Ast* parse_funcall(Env* env, Tokens ts, Symbol name) {
   Ast** const args = new_Ast_array(MAX_ARGC);
   Token t = pop_Token(ts);
-  if(t.type != OPEN_PAREN_T || head_char(t.string) != '(') {
+  if(t.type != OPEN_PAREN_T || Token_head(t) != '(') {
     warn("###");
   }
   int argc = 0;
   for(; argc <= MAX_ARGC; ++argc) {
     t = peek_Token(ts);
-    if(t.type == CLOSE_PAREN_T && head_char(t.string) == ')') {
+    if(t.type == CLOSE_PAREN_T && Token_head(t) == ')') {
       pop_Token(ts);
       break;
     }
@@ -414,9 +421,9 @@ Ast* parse_funcall(Env* env, Tokens ts, char const* name) {
     args[argc - 1] = parse_expr(env, ts);
     t = pop_Token(ts);
     if(t.type == EOF_T) { warn("unexpected EOF\n"); return NULL; }
-    if(head_char(t.string) == ')') { break; }
-    if(head_char(t.string) == ',') { /* nop */ }
-    else { warn("unexpected token(%s)\n", c_str(t.string)); return NULL; }
+    if(Token_head(t) == ')') { break; }
+    if(Token_head(t) == ',') { /* nop */ }
+    else { warn("unexpected token(%s)\n", Token_c_str(t)); return NULL; }
   }
   if(argc > MAX_ARGC) {
     warn("too many arg(max argc is %d)\n", MAX_ARGC);
@@ -440,7 +447,7 @@ int priority(char op) {
 }
 
 bool compare_with_name(Var* lhs, Var* rhs) {
-  return !strcmp(lhs->name, rhs->name);
+  return lhs->name == rhs->name;
 }
 
 Ast* parse_expr_imp(Env* env, Tokens ts, int prio) {
@@ -448,37 +455,36 @@ Ast* parse_expr_imp(Env* env, Tokens ts, int prio) {
   assert(ast != NULL);
   while(true) {
     Token const t = pop_Token(ts);
-    char const* str = c_str(t.string);
     if(!is_op(t.type)) {
-      push_Token(ts, t);
+      unget_Token(ts);
       return ast;
     }
-    if(!strcmp(str, "+") ||
-       !strcmp(str, "-") ||
-       !strcmp(str, "*") ||
-       !strcmp(str, "/")) {
-      char const c = str[0];
+    TokenType const type = t.type;
+    if(type == OP_PLUS_T ||
+       type == OP_MINUS_T ||
+       type == OP_MULTI_T ||
+       type == OP_DIV_T) {
+      char const c = Token_head(t);
       int const c_prio = priority(c);
       if(c_prio < prio) {
-        push_Token(ts, t);
+        unget_Token(ts);
         return ast;
       }
-      TokenType const type = to_TokenType(c_str(t.string));
       Ast* const lhs = ast;
       Ast* const rhs = parse_expr_imp(env, ts, c_prio + 1);
       ast = make_ast_bi_op(type, lhs, rhs);
-    } else if(!strcmp(str, "=")) {
+    } else if(type == OP_ASSIGN_T) {
       Ast* const lhs = ast;
       Ast* const rhs = parse_expr_imp(env, ts, prio);
       assert(lhs->type == AST_SYM);
       lhs->var->initialized = true;
       ast = make_ast_bi_op(OP_ASSIGN_T, lhs, rhs);
-    } else if(!strcmp(str, "==")) {
+    } else if(type == OP_EQUAL_T) {
       Ast* const lhs = ast;
       Ast* const rhs = parse_expr_imp(env, ts, prio);
       ast = make_ast_bi_op(OP_EQUAL_T, lhs, rhs);
     } else {
-      warn("never come!!!(got: %s)(token type: %s)\n", str, show_TokenType(t.type));
+      warn("never come!!!(got: %s)(token type: %s)\n", Token_c_str(t), show_TokenType(t.type));
       return NULL;
     }
   }
@@ -495,7 +501,7 @@ bool parse_semicolon(Tokens ts) {
   if(t.type != SEMICOLON_T) {
     if(t.type == EOF_T) { warn("unterminated expr(got unexpeced EOF)\n"); }
     else {
-      warn("unterminated expr(got %s)\n", c_str(t.string));
+      warn("unterminated expr(got %s)\n", Token_c_str(t));
     }
     return false;
   }
@@ -503,9 +509,9 @@ bool parse_semicolon(Tokens ts) {
 }
 
 Statement* parse_sym_define(Env* env, Tokens ts, Type* type) {
-  char const* sym_name = c_str(pop_Token(ts).string);
+  Symbol const sym_name = pop_Token(ts).sym;
   Token const token = peek_Token(ts);
-  char const c = head_char(token.string);
+  char const c = Token_head(token);
   if(token.type == SEMICOLON_T) {
     // sym define
     return make_statement(make_ast_val_define(env, type, sym_name));
@@ -514,26 +520,26 @@ Statement* parse_sym_define(Env* env, Tokens ts, Type* type) {
     // sym define with init val
     return NULL;
   }
-  warn("unexpected token(%s)\n", c_str(token.string));
+  warn("unexpected token(%s)\n", Token_c_str(token));
   return NULL;
 }
 
 Statement* parse_if_statement(Env* env, Tokens ts) {
   Token t = pop_Token(ts);
-  if(t.type != OPEN_PAREN_T || head_char(t.string) != '(') {
-    warn("unexpected token %s\n", c_str(t.string));
+  if(t.type != OPEN_PAREN_T || Token_head(t) != '(') {
+    warn("unexpected token %s\n", Token_c_str(t));
     return NULL;
   }
   Ast* cond = parse_expr(env, ts);
   t = pop_Token(ts);
-  if(t.type != CLOSE_PAREN_T || head_char(t.string) != ')') {
-    warn("unexpected token %s\n", c_str(t.string));
+  if(t.type != CLOSE_PAREN_T || Token_head(t) != ')') {
+    warn("unexpected token %s\n", Token_c_str(t));
     return NULL;
   }
   Statement* body = parse_statement(env, ts);
   Statement* else_body = NULL;
   t = peek_Token(ts);
-  if(t.type == KEYWORD_T && !strcmp(c_str(t.string), "else")) {
+  if(t.keyword == KW_ELSE) {
     pop_Token(ts);
     else_body = parse_statement(env, ts);
   }
@@ -542,14 +548,14 @@ Statement* parse_if_statement(Env* env, Tokens ts) {
 
 Statement* parse_while_statement(Env* env, Tokens ts) {
   Token t = pop_Token(ts);
-  if(t.type != OPEN_PAREN_T || head_char(t.string) != '(') {
-    warn("unexpected token %s\n", c_str(t.string));
+  if(t.type != OPEN_PAREN_T || Token_head(t) != '(') {
+    warn("unexpected token %s\n", Token_c_str(t));
     return NULL;
   }
   Ast* cond = parse_expr(env, ts);
   t = pop_Token(ts);
-  if(t.type != CLOSE_PAREN_T || head_char(t.string) != ')') {
-    warn("unexpected token %s\n", c_str(t.string));
+  if(t.type != CLOSE_PAREN_T || Token_head(t) != ')') {
+    warn("unexpected token %s\n", Token_c_str(t));
     return NULL;
   }
   Statement* body = parse_statement(env, ts);
@@ -564,7 +570,7 @@ Statement* parse_statement(Env* env, Tokens ts) {
       Ast* const ast = new_Ast();
       ast->type = AST_EMPTY;
       return make_statement(ast);
-    } else if(t.type == OPEN_PAREN_T && head_char(t.string) == '{') {
+    } else if(t.type == OPEN_PAREN_T && Token_head(t) == '{') {
       return make_statement(parse_block(env, ts));
     }
   }
@@ -579,20 +585,22 @@ Statement* parse_statement(Env* env, Tokens ts) {
 
   bool is_return = false;
   Token token = peek_Token(ts);
-  if(token.type == KEYWORD_T && !strcmp(c_str(token.string), "return")) {
+  switch(token.keyword) {
+  case KW_RETURN:
     // return statement
     pop_Token(ts);
     is_return = true;
-  }
-  if(token.type == KEYWORD_T && !strcmp(c_str(token.string), "if")) {
+    break;
+  case KW_IF:
     // if statement
     pop_Token(ts);
     return parse_if_statement(env, ts);
-  }
-  if(token.type == KEYWORD_T && !strcmp(c_str(token.string), "while")) {
+  case KW_WHILE:
     // while statement
     pop_Token(ts);
     return parse_while_statement(env, ts);
+  default:
+    break;
   }
 
   Ast* const ast = parse_expr(env, ts);
@@ -612,7 +620,7 @@ Ast* parse_statements(Env* env, Tokens ts) {
   INTRUSIVE_LIST_OF(Statement) ss = new_list_of_Statement();
   Token t;
   while(t = peek_Token(ts), t.type != EOF_T) {
-    char const c = head_char(t.string);
+    char const c = Token_head(t);
     if(t.type == CLOSE_PAREN_T && c == '}') {
       // end of block
       break;
@@ -627,16 +635,16 @@ Ast* parse_statements(Env* env, Tokens ts) {
 Ast* parse_block(Env* env, Tokens ts) {
   Token t = pop_Token(ts);
   Env* expanded = expand_Env(env);
-  char c = head_char(t.string);
+  char c = Token_head(t);
   if(t.type != OPEN_PAREN_T || c != '{') {
-    warn("unexpected token(%s)\n", c_str(t.string));
+    warn("unexpected token(%s)\n", Token_c_str(t));
     return NULL;
   }
   Ast* const ss = parse_statements(expanded, ts);
   t = pop_Token(ts);
-  c = head_char(t.string);
+  c = Token_head(t);
   if(t.type != CLOSE_PAREN_T || c != '}') {
-    warn("unexpected token(%s)\n", c_str(t.string));
+    warn("unexpected token(%s)\n", Token_c_str(t));
     return NULL;
   }
   assert(ss->type == AST_STATEMENTS);
@@ -647,27 +655,25 @@ Ast* parse_block(Env* env, Tokens ts) {
 Type* parse_type(Env* env, Tokens ts) {
   Token const t = pop_Token(ts);
   if(t.type == KEYWORD_T) {
-    char const* const str = c_str(t.string);
-    char const* const types[] = {
-      "int",
-      "char"
-    };
-    for(int i = 0; i < (int)(sizeof(types)/sizeof(*types)); ++i) {
-      if(!strcmp(str, types[i])) {
-        Type* const type = find_type_by_name(env, types[i]);
-        assert(type != NULL);
-        return type;
-      }
+    switch(t.keyword) {
+    case KW_INT:
+    case KW_CHAR:
+      break;
+    default:
+      unget_Token(ts);
+      return NULL;
     }
-    assert("never come!(unimpled");
+    Type* const type = find_type_by_name(env, t.sym);
+    assert(type != NULL);
+    return type;
   }
   if(t.type != IDENTIFIER_T) {
-    push_Token(ts, t);
+    unget_Token(ts);
     return NULL;
   }
-  Type* const type = find_type_by_name(env, c_str(t.string));
+  Type* const type = find_type_by_name(env, t.sym);
   if(type == NULL) {
-    push_Token(ts, t);
+    unget_Token(ts);
     return NULL;
   }
   return type;
@@ -675,9 +681,9 @@ Type* parse_type(Env* env, Tokens ts) {
 
 Ast* parse_fundef(Env* env, Tokens ts) {
   Type* const ret_type = parse_type(env, ts);
-  char const* const name = c_str(pop_Token(ts).string);
+  Symbol const name = pop_Token(ts).sym;
   Token open = pop_Token(ts);
-  char const o = head_char(open.string);
+  char const o = Token_head(open);
   if(open.type != OPEN_PAREN_T
      || o != '(') {
     warn("unexpected char(%c)\n", o);
@@ -689,7 +695,7 @@ Ast* parse_fundef(Env* env, Tokens ts) {
   int argc = 0;
   for(; argc <= MAX_ARGC + 1; ++argc) {
     Token const t = peek_Token(ts);
-    char const c = head_char(t.string);
+    char const c = Token_head(t);
     if(t.type == CLOSE_PAREN_T && c == ')') {
       pop_Token(ts);
       break;
@@ -697,10 +703,10 @@ Ast* parse_fundef(Env* env, Tokens ts) {
     if(argc == 0) { continue; }
     Type* const type = parse_type(env, ts);
     arg_types[argc - 1] = type;
-    char const* const name = c_str(pop_Token(ts).string);
+    Symbol const name = pop_Token(ts).sym;
     args[argc - 1] = add_sym_to_env(expanded, type, name);
     Token const t2 = peek_Token(ts);
-    char const c2 = head_char(t2.string);
+    char const c2 = Token_head(t2);
     if(t2.type == COMMA_T) {
       pop_Token(ts);
     }
@@ -736,7 +742,7 @@ Ast* parse(Env* env, Tokens ts) {
 
 Ast* make_ast(Env* env, Tokens ts) {
   Ast* const ast = parse(env, ts);
-  if(list_of_Token_length(ts) != 1) {
+  if(Tokens_rest(ts) != 1) {
     warn("token remains! possible parser bug. rest tokens are here:\n");
     print_Tokens(ts);
   }
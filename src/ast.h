@@ -4,6 +4,7 @@
 #include "enum.h"
 #include "tokenize.h"
 #include "list.h"
+#include "symbol.h"
 
 ENUM_WITH_SHOW(
   AstType,
@@ -61,23 +62,23 @@ DEFINE_INTRUSIVE_LIST(Statement);
 DEFINE_INTRUSIVE_LIST(Ast);
 
 typedef struct Bi_op {
-  Ast const* lhs;
-  Ast const* rhs;
+  Ast* lhs;
+  Ast* rhs;
   TokenType op_type;
 } Bi_op;
 
 struct Type {
-  char const* name;
+  Symbol name;
   int size;
   INTRUSIVE_LIST_HOOK(Type);
 };
 
 struct Var {
-  char const* name;
+  Symbol name;
   Type* type;
   bool initialized;
   bool defined;
-  int offset;
+  int id; // vreg, assigned when the function is lowered
   INTRUSIVE_LIST_HOOK(Var);
 };
 
@@ -108,9 +109,10 @@ struct Block {
 };
 
 struct FunCall {
-  char const* name;
+  Symbol name;
   int argc;
   Ast** args;
+  int id; // callee, resolved by the interpreter
 };
 
 struct FunType {
@@ -121,7 +123,7 @@ struct FunType {
 
 struct FunDef {
   FunType type;
-  char const* name;
+  Symbol name;
   Var** args;
   Ast* body;
 };
@@ -149,6 +151,8 @@ struct Ast {
 Env* new_Env();
 Ast* make_ast(Env*, Tokens);
 Ast* make_ast_statement(Statement*);
+Ast* make_ast_int(int);
+Ast* make_ast_bi_op(TokenType, Ast*, Ast*);
 int var_count(Env const*);
 void print_ast(Ast const*);
 void print_env(Env const*);
@@ -0,0 +1,56 @@
+#include <string.h>
+#include "arena.h"
+#include "bitset.h"
+
+BitSet* new_BitSet(int size) {
+  BitSet* const s = region_alloc(CODEGEN_REGION, sizeof(BitSet));
+  s->size = size;
+  s->words = region_alloc(CODEGEN_REGION, sizeof(uint64_t) * (BitSet_words(size) + 1));
+  BitSet_clear(s);
+  return s;
+}
+
+void BitSet_add(BitSet* s, int n) {
+  assert(0 <= n && n < s->size);
+  s->words[n / 64] |= (uint64_t)1 << (n % 64);
+}
+
+bool BitSet_has(BitSet const* s, int n) {
+  assert(0 <= n && n < s->size);
+  return (s->words[n / 64] >> (n % 64)) & 1;
+}
+
+void BitSet_clear(BitSet* s) {
+  memset(s->words, 0, sizeof(uint64_t) * BitSet_words(s->size));
+}
+
+void BitSet_copy(BitSet* dst, BitSet const* src) {
+  assert(dst->size == src->size);
+  memcpy(dst->words, src->words, sizeof(uint64_t) * BitSet_words(src->size));
+}
+
+bool BitSet_union(BitSet* dst, BitSet const* src) {
+  assert(dst->size == src->size);
+  uint64_t changed = 0;
+  for(int i = 0; i < BitSet_words(src->size); ++i) {
+    uint64_t const w = dst->words[i] | src->words[i];
+    changed |= w ^ dst->words[i];
+    dst->words[i] = w;
+  }
+  return changed != 0;
+}
+
+int BitSet_next(BitSet const* s, int from) {
+  if(from >= s->size) {
+    return -1;
+  }
+  int w = from / 64;
+  uint64_t bits = s->words[w] & (~(uint64_t)0 << (from % 64));
+  while(bits == 0) {
+    if(++w >= BitSet_words(s->size)) {
+      return -1;
+    }
+    bits = s->words[w];
+  }
+  return w * 64 + __builtin_ctzll(bits);
+}
@@ -0,0 +1,28 @@
+#ifndef NNA774_KONOHA_BITSET_H
+#define NNA774_KONOHA_BITSET_H
+
+#include <stdint.h>
+#include "utils.h"
+
+// fixed size set of small integers(vregs, blocks). allocated in CODEGEN_REGION
+struct BitSet;
+typedef struct BitSet BitSet;
+
+struct BitSet {
+  int size;
+  uint64_t* words;
+};
+
+BitSet* new_BitSet(int size);
+void BitSet_add(BitSet*, int);
+bool BitSet_has(BitSet const*, int);
+void BitSet_clear(BitSet*);
+void BitSet_copy(BitSet* dst, BitSet const* src);
+// dst |= src. returns whether dst changed
+bool BitSet_union(BitSet* dst, BitSet const* src);
+// the smallest member >= from, or -1
+int BitSet_next(BitSet const*, int from);
+
+#define BitSet_words(size) (((size) + 63) / 64)
+
+#endif // NNA774_KONOHA_BITSET_H
@@ -0,0 +1,267 @@
+#include <stdint.h>
+#include "arena.h"
+#include "bytecode.h"
+
+int bc_inst_length(int32_t const* inst) {
+  switch(inst[0]) {
+  case BC_RET0:
+    return 1;
+  case BC_JMP:
+  case BC_RET:
+    return 2;
+  case BC_CONST:
+  case BC_MOV:
+  case BC_NEG:
+  case BC_JZ:
+  case BC_JNZ:
+    return 3;
+  case BC_ADD:
+  case BC_SUB:
+  case BC_MUL:
+  case BC_DIV:
+  case BC_EQ:
+  case BC_SHL:
+  case BC_SAR:
+  case BC_SHR:
+    return 4;
+  case BC_CALL:
+    return 4 + inst[3];
+  case BC_TAIL:
+    return 3 + inst[2];
+  default:
+    return 0;
+  }
+}
+
+struct BcCompiler;
+typedef struct BcCompiler BcCompiler;
+
+struct BcCompiler {
+  EmitOption option;
+  KbcFunction* funcs;
+  int func_count;
+  int func_capacity;
+  SymbolMap* func_indices; // index + 1
+  Writer* strings;
+  int32_t* code;
+  int code_count;
+  int code_capacity;
+  // of the function being compiled
+  IrFunc const* func;
+  int start;
+  int* block_offsets;
+  int* fixups; // code indices of jump targets, holding a block until they're patched
+  int fixup_count;
+  int fixup_capacity;
+};
+
+int function_index(BcCompiler* c, Symbol name) {
+  intptr_t const found = (intptr_t)SymbolMap_find(c->func_indices, name);
+  if(found != 0) {
+    return found - 1;
+  }
+  GROW_ARRAY(KbcFunction, c->funcs, c->func_count, c->func_capacity, 16);
+  KbcFunction* const f = &c->funcs[c->func_count];
+  f->name = c->strings->length;
+  write_bytes(c->strings, name, strlen(name) + 1);
+  f->argc = 0;
+  f->frame_size = 0;
+  f->code = KBC_UNDEFINED;
+  f->length = 0;
+  SymbolMap_insert(c->func_indices, name, (void*)(intptr_t)(c->func_count + 1));
+  return c->func_count++;
+}
+
+void put_word(BcCompiler* c, int32_t word) {
+  GROW_ARRAY(int32_t, c->code, c->code_count, c->code_capacity, 256);
+  c->code[c->code_count++] = word;
+}
+
+// args take the first registers of the frame
+void put_reg(BcCompiler* c, Vreg v) {
+  assert(v >= 0);
+  put_word(c, c->func->argc + v);
+}
+
+void put_target(BcCompiler* c, int block) {
+  GROW_ARRAY(int, c->fixups, c->fixup_count, c->fixup_capacity, 16);
+  c->fixups[c->fixup_count++] = c->code_count;
+  put_word(c, block);
+}
+
+BcOp BcOp_from_IrOp(IrOp op) {
+  switch(op) {
+  case IR_ADD:
+    return BC_ADD;
+  case IR_SUB:
+    return BC_SUB;
+  case IR_MUL:
+    return BC_MUL;
+  case IR_DIV:
+    return BC_DIV;
+  case IR_EQ:
+    return BC_EQ;
+  case IR_SHL:
+    return BC_SHL;
+  case IR_SAR:
+    return BC_SAR;
+  default:
+    return BC_SHR;
+  }
+}
+
+void compile_call(BcCompiler* c, IrInst const* inst, bool tail) {
+  put_word(c, tail ? BC_TAIL : BC_CALL);
+  if(!tail) {
+    put_reg(c, inst->dst);
+  }
+  put_word(c, function_index(c, inst->name));
+  put_word(c, inst->call.argc);
+  for(int i = 0; i < inst->call.argc; ++i) {
+    put_reg(c, c->func->call_args[inst->call.args + i]);
+  }
+}
+
+// `call; ret` of its result
+bool is_bc_tail_call(BcCompiler const* c, IrBlock const* b, int index) {
+  IrInst const* const inst = &b->insts[index];
+  if(!c->option.tail_calls || inst->op != IR_CALL) {
+    return false;
+  }
+  IrInst const* const next = &b->insts[index + 1];
+  return next->op == IR_RET && (next->a == NO_VREG || next->a == inst->dst);
+}
+
+// block is the index of the one containing inst, whose successor in the layout is block + 1
+void compile_inst(BcCompiler* c, int block, IrInst const* inst) {
+  switch(inst->op) {
+  case IR_CONST:
+    put_word(c, BC_CONST);
+    put_reg(c, inst->dst);
+    put_word(c, inst->imm);
+    break;
+  case IR_PARAM:
+    put_word(c, BC_MOV);
+    put_reg(c, inst->dst);
+    put_word(c, inst->imm);
+    break;
+  case IR_MOV:
+    put_word(c, BC_MOV);
+    put_reg(c, inst->dst);
+    put_reg(c, inst->a);
+    break;
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_EQ:
+    put_word(c, BcOp_from_IrOp(inst->op));
+    put_reg(c, inst->dst);
+    put_reg(c, inst->a);
+    put_reg(c, inst->b);
+    break;
+  case IR_NEG:
+    put_word(c, BC_NEG);
+    put_reg(c, inst->dst);
+    put_reg(c, inst->a);
+    break;
+  case IR_SHL:
+  case IR_SAR:
+  case IR_SHR:
+    put_word(c, BcOp_from_IrOp(inst->op));
+    put_reg(c, inst->dst);
+    put_reg(c, inst->a);
+    put_word(c, inst->imm);
+    break;
+  case IR_CALL:
+    compile_call(c, inst, false);
+    break;
+  case IR_JMP:
+    if(inst->target[0] != block + 1) {
+      put_word(c, BC_JMP);
+      put_target(c, inst->target[0]);
+    }
+    break;
+  case IR_BR:
+    if(inst->target[0] == block + 1) {
+      put_word(c, BC_JZ);
+      put_reg(c, inst->a);
+      put_target(c, inst->target[1]);
+      break;
+    }
+    put_word(c, BC_JNZ);
+    put_reg(c, inst->a);
+    put_target(c, inst->target[0]);
+    if(inst->target[1] != block + 1) {
+      put_word(c, BC_JMP);
+      put_target(c, inst->target[1]);
+    }
+    break;
+  case IR_RET:
+    if(inst->a == NO_VREG) {
+      put_word(c, BC_RET0);
+    } else {
+      put_word(c, BC_RET);
+      put_reg(c, inst->a);
+    }
+    break;
+  case IR_PHI:
+  case IR_NOP:
+    warn("%s is left in %s\n", show_IrOp(inst->op), c->func->name);
+    break;
+  }
+}
+
+void compile_func(BcCompiler* c, IrFunc const* f) {
+  c->func = f;
+  c->start = c->code_count;
+  c->block_offsets = region_alloc(CODEGEN_REGION, sizeof(int) * (f->block_count + 1));
+  c->fixup_count = 0;
+  for(int i = 0; i < f->block_count; ++i) {
+    c->block_offsets[i] = c->code_count - c->start;
+    IrBlock const* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      if(is_bc_tail_call(c, b, j)) {
+        compile_call(c, &b->insts[j], true);
+        ++j; // the ret
+        continue;
+      }
+      compile_inst(c, i, &b->insts[j]);
+    }
+  }
+  for(int i = 0; i < c->fixup_count; ++i) {
+    int32_t* const target = &c->code[c->fixups[i]];
+    *target = c->block_offsets[*target];
+  }
+  int const index = function_index(c, f->name); // may move funcs
+  KbcFunction* const kf = &c->funcs[index];
+  if(kf->code != KBC_UNDEFINED) {
+    warn("%s is defined twice\n", f->name);
+  }
+  kf->argc = f->argc;
+  kf->frame_size = f->argc + f->vreg_count;
+  kf->code = c->start;
+  kf->length = c->code_count - c->start;
+}
+
+void emit_bytecode(FILE* outfile, IrProgram const* program, EmitOption const* option) {
+  BcCompiler compiler = { *option, NULL, 0, 0, new_SymbolMap(), new_buffer_Writer(), NULL, 0, 0, NULL, 0, NULL, NULL, 0, 0 };
+  BcCompiler* const c = &compiler;
+  for(int i = 0; i < program->count; ++i) {
+    compile_func(c, &program->funcs[i]);
+  }
+
+  KbcHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, KBC_MAGIC, sizeof(header.magic));
+  header.version = KBC_VERSION;
+  header.function_count = c->func_count;
+  header.code_size = c->code_count;
+  header.string_size = c->strings->length;
+  Writer* const out = new_Writer(outfile);
+  write_bytes(out, (char const*)&header, sizeof(header));
+  write_bytes(out, (char const*)c->funcs, sizeof(KbcFunction) * c->func_count);
+  write_bytes(out, (char const*)c->code, sizeof(int32_t) * c->code_count);
+  append_Writer(out, c->strings);
+  flush_Writer(out);
+}
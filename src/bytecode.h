@@ -0,0 +1,81 @@
+#ifndef NNA774_KONOHA_BYTECODE_H
+#define NNA774_KONOHA_BYTECODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "emit.h"
+#include "enum.h"
+#include "ir.h"
+
+// register bytecode(.kbc). a file is, in order and little-endian:
+//   KbcHeader
+//   KbcFunction[function_count]
+//   int32_t code[code_size]
+//   char strings[string_size], the NUL-terminated names
+// everything refers to the rest by index or offset, never by address, so a
+// file can be mapped anywhere and run as it is.
+//
+// an instruction is its BcOp followed by its operands, one int32_t each.
+// registers are indices into the frame of the function, whose args come first.
+// jump targets are code indices from the start of the function
+
+ENUM_WITH_SHOW(
+  BcOp,
+  BC_CONST, // dst imm
+  BC_MOV,   // dst a
+  BC_ADD,   // dst a b
+  BC_SUB,   // dst a b
+  BC_MUL,   // dst a b
+  BC_DIV,   // dst a b
+  BC_EQ,    // dst a b
+  BC_NEG,   // dst a
+  BC_SHL,   // dst a imm
+  BC_SAR,   // dst a imm
+  BC_SHR,   // dst a imm
+  BC_JMP,   // target
+  BC_JZ,    // a target
+  BC_JNZ,   // a target
+  BC_CALL,  // dst function argc args...
+  BC_TAIL,  // function argc args...: returns what the call returns
+  BC_RET,   // a
+  BC_RET0,  // returns 0
+  NUMBER_OF_BC_OPS,
+)
+
+// "\x7fKBC"
+#define KBC_MAGIC "\177KBC"
+// bumped whenever the layout or an instruction changes
+#define KBC_VERSION 1
+// KbcFunction.code of functions left to the host(see host.h)
+#define KBC_UNDEFINED UINT32_MAX
+
+struct KbcHeader;
+typedef struct KbcHeader KbcHeader;
+struct KbcFunction;
+typedef struct KbcFunction KbcFunction;
+
+struct KbcHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t function_count;
+  uint32_t code_size; // in int32_ts
+  uint32_t string_size;
+};
+
+struct KbcFunction {
+  uint32_t name; // offset into strings
+  uint32_t argc;
+  uint32_t frame_size; // registers
+  uint32_t code; // index of the first instruction or KBC_UNDEFINED
+  uint32_t length;
+};
+
+// the length of the instruction at inst in int32_ts, or 0 if it has an unknown op.
+// its operands are read only with a BC_CALL or BC_TAIL, for their argc
+int bc_inst_length(int32_t const* inst);
+
+// every function of program as a .kbc file. from -O1(option->tail_calls),
+// `call; ret` becomes BC_TAIL
+void emit_bytecode(FILE* outfile, IrProgram const* program, EmitOption const* option);
+
+#endif // NNA774_KONOHA_BYTECODE_H
@@ -0,0 +1,235 @@
+#include "arena.h"
+#include "cfg.h"
+
+void* new_cfg_array(int count, size_t size) {
+  return region_alloc(CODEGEN_REGION, size * (count + 1));
+}
+
+void compute_preds(Cfg* cfg, IrFunc const* f) {
+  int const n = f->block_count;
+  cfg->pred_count = new_cfg_array(n, sizeof(int));
+  cfg->preds = new_cfg_array(n, sizeof(int*));
+  for(int i = 0; i < n; ++i) {
+    cfg->pred_count[i] = 0;
+  }
+  for(int i = 0; i < n; ++i) {
+    int succ[2];
+    int const succ_count = IrBlock_successors(&f->blocks[i], succ);
+    for(int j = 0; j < succ_count; ++j) {
+      ++cfg->pred_count[succ[j]];
+    }
+  }
+  for(int i = 0; i < n; ++i) {
+    cfg->preds[i] = new_cfg_array(cfg->pred_count[i], sizeof(int));
+    cfg->pred_count[i] = 0;
+  }
+  for(int i = 0; i < n; ++i) {
+    int succ[2];
+    int const succ_count = IrBlock_successors(&f->blocks[i], succ);
+    for(int j = 0; j < succ_count; ++j) {
+      cfg->preds[succ[j]][cfg->pred_count[succ[j]]++] = i;
+    }
+  }
+}
+
+// iterative DFS from the entry
+void compute_rpo(Cfg* cfg, IrFunc const* f) {
+  int const n = f->block_count;
+  int* const postorder = new_cfg_array(n, sizeof(int));
+  int* const stack = new_cfg_array(n, sizeof(int));
+  int* const next_succ = new_cfg_array(n, sizeof(int));
+  bool* const visited = new_cfg_array(n, sizeof(bool));
+  for(int i = 0; i < n; ++i) {
+    visited[i] = false;
+    next_succ[i] = 0;
+  }
+  int count = 0;
+  int sp = 0;
+  stack[sp++] = 0;
+  visited[0] = true;
+  while(sp != 0) {
+    int const b = stack[sp - 1];
+    int succ[2];
+    int const succ_count = IrBlock_successors(&f->blocks[b], succ);
+    if(next_succ[b] < succ_count) {
+      int const s = succ[next_succ[b]++];
+      if(!visited[s]) {
+        visited[s] = true;
+        stack[sp++] = s;
+      }
+    } else {
+      postorder[count++] = b;
+      --sp;
+    }
+  }
+  cfg->rpo = new_cfg_array(count, sizeof(int));
+  cfg->rpo_count = count;
+  cfg->rpo_index = new_cfg_array(n, sizeof(int));
+  for(int i = 0; i < n; ++i) {
+    cfg->rpo_index[i] = -1;
+  }
+  for(int i = 0; i < count; ++i) {
+    cfg->rpo[i] = postorder[count - 1 - i];
+    cfg->rpo_index[cfg->rpo[i]] = i;
+  }
+}
+
+int intersect(Cfg const* cfg, int a, int b) {
+  while(a != b) {
+    while(cfg->rpo_index[a] > cfg->rpo_index[b]) {
+      a = cfg->idom[a];
+    }
+    while(cfg->rpo_index[b] > cfg->rpo_index[a]) {
+      b = cfg->idom[b];
+    }
+  }
+  return a;
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+void compute_idom(Cfg* cfg) {
+  int const n = cfg->block_count;
+  cfg->idom = new_cfg_array(n, sizeof(int));
+  for(int i = 0; i < n; ++i) {
+    cfg->idom[i] = -1;
+  }
+  cfg->idom[0] = 0;
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(int i = 1; i < cfg->rpo_count; ++i) {
+      int const b = cfg->rpo[i];
+      int idom = -1;
+      for(int j = 0; j < cfg->pred_count[b]; ++j) {
+        int const p = cfg->preds[b][j];
+        if(cfg->idom[p] < 0) {
+          continue;
+        }
+        idom = idom < 0 ? p : intersect(cfg, p, idom);
+      }
+      if(cfg->idom[b] != idom) {
+        cfg->idom[b] = idom;
+        changed = true;
+      }
+    }
+  }
+
+  cfg->child_count = new_cfg_array(n, sizeof(int));
+  cfg->children = new_cfg_array(n, sizeof(int*));
+  for(int i = 0; i < n; ++i) {
+    cfg->child_count[i] = 0;
+  }
+  for(int i = 1; i < cfg->rpo_count; ++i) {
+    ++cfg->child_count[cfg->idom[cfg->rpo[i]]];
+  }
+  for(int i = 0; i < n; ++i) {
+    cfg->children[i] = new_cfg_array(cfg->child_count[i], sizeof(int));
+    cfg->child_count[i] = 0;
+  }
+  for(int i = 1; i < cfg->rpo_count; ++i) {
+    int const b = cfg->rpo[i];
+    int const parent = cfg->idom[b];
+    cfg->children[parent][cfg->child_count[parent]++] = b;
+  }
+}
+
+Cfg* compute_Cfg(IrFunc const* f) {
+  Cfg* const cfg = region_alloc(CODEGEN_REGION, sizeof(Cfg));
+  cfg->block_count = f->block_count;
+  compute_preds(cfg, f);
+  compute_rpo(cfg, f);
+  compute_idom(cfg);
+  return cfg;
+}
+
+bool Cfg_reachable(Cfg const* cfg, int block) {
+  return cfg->rpo_index[block] >= 0;
+}
+
+bool Cfg_dominates(Cfg const* cfg, int a, int b) {
+  if(!Cfg_reachable(cfg, b)) {
+    return false;
+  }
+  while(b != a && b != 0) {
+    b = cfg->idom[b];
+  }
+  return b == a;
+}
+
+BitSet** dominance_frontiers(Cfg const* cfg) {
+  int const n = cfg->block_count;
+  BitSet** const df = new_cfg_array(n, sizeof(BitSet*));
+  for(int i = 0; i < n; ++i) {
+    df[i] = new_BitSet(n);
+  }
+  for(int b = 0; b < n; ++b) {
+    if(!Cfg_reachable(cfg, b) || cfg->pred_count[b] < 2) {
+      continue;
+    }
+    for(int j = 0; j < cfg->pred_count[b]; ++j) {
+      int runner = cfg->preds[b][j];
+      if(!Cfg_reachable(cfg, runner)) {
+        continue;
+      }
+      while(runner != cfg->idom[b]) {
+        BitSet_add(df[runner], b);
+        runner = cfg->idom[runner];
+      }
+    }
+  }
+  return df;
+}
+
+void prune_unreachable_blocks(IrFunc* f) {
+  Cfg const* const cfg = compute_Cfg(f);
+  if(cfg->rpo_count == f->block_count) {
+    return;
+  }
+  int* const order = new_cfg_array(f->block_count, sizeof(int));
+  int n = 0;
+  for(int i = 0; i < f->block_count; ++i) {
+    if(Cfg_reachable(cfg, i)) {
+      order[n++] = i;
+    }
+  }
+  reorder_IrBlocks(f, order, n);
+}
+
+void merge_blocks(IrFunc* f) {
+  int const n = f->block_count;
+  Cfg const* const cfg = compute_Cfg(f);
+  bool* const merged = new_cfg_array(n, sizeof(bool));
+  for(int i = 0; i < n; ++i) {
+    merged[i] = false;
+  }
+  for(int i = 0; i < n; ++i) {
+    if(merged[i]) {
+      continue;
+    }
+    IrBlock* const b = &f->blocks[i];
+    while(true) {
+      IrInst const* const t = IrBlock_terminator(b);
+      int const next = t->target[0];
+      if(t->op != IR_JMP || next == 0 || next == i || cfg->pred_count[next] != 1) {
+        break;
+      }
+      IrBlock const* const nb = &f->blocks[next];
+      if(nb->insts[0].op == IR_PHI) {
+        break;
+      }
+      --b->count; // the jmp
+      for(int j = 0; j < nb->count; ++j) {
+        *append_IrInst(f, i, IR_NOP) = nb->insts[j];
+      }
+      merged[next] = true;
+    }
+  }
+  int* const order = new_cfg_array(n, sizeof(int));
+  int count = 0;
+  for(int i = 0; i < n; ++i) {
+    if(!merged[i]) {
+      order[count++] = i;
+    }
+  }
+  reorder_IrBlocks(f, order, count);
+}
@@ -0,0 +1,33 @@
+#ifndef NNA774_KONOHA_CFG_H
+#define NNA774_KONOHA_CFG_H
+
+#include "bitset.h"
+#include "ir.h"
+
+// predecessors and dominators of an IrFunc's blocks.
+// stale once blocks or jumps are changed
+struct Cfg;
+typedef struct Cfg Cfg;
+
+struct Cfg {
+  int block_count;
+  int** preds;
+  int* pred_count;
+  int* rpo; // reachable blocks in reverse postorder
+  int rpo_count;
+  int* rpo_index; // -1 if unreachable
+  int* idom; // immediate dominator. the entry is its own, -1 if unreachable
+  int** children; // dominator tree
+  int* child_count;
+};
+
+Cfg* compute_Cfg(IrFunc const*);
+bool Cfg_reachable(Cfg const*, int block);
+bool Cfg_dominates(Cfg const*, int a, int b);
+BitSet** dominance_frontiers(Cfg const*);
+// drops unreachable blocks, keeping the layout of the others
+void prune_unreachable_blocks(IrFunc*);
+// appends a block to the one jumping to it when that's its only predecessor
+void merge_blocks(IrFunc*);
+
+#endif // NNA774_KONOHA_CFG_H
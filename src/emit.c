@@ -1,213 +1,622 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <assert.h>
 #include <string.h>
+#include "arena.h"
 #include "emit.h"
+#include "encode.h"
+#include "liveness.h"
+#include "peephole.h"
+#include "writer.h"
+#include "x86.h"
 
-void emit_ast_impl(FILE* outfile, Ast const* ast, Env const* env, int depth, char const* to);
+// vregs are allocated to these. %eax/%edx are scratch(and idivl's).
+unsigned const ALLOCATABLE_MASK = 1u << RBX | 1u << R12 | 1u << R13 | 1u << R14 | 1u << R15
+  | 1u << R10 | 1u << R11 | 1u << RCX | 1u << RSI | 1u << RDI | 1u << R8 | 1u << R9;
 
-char const* const REGS[] = {"edi", "esi", "edx", "ecx", "r8d", "r9d"};
-int const MAX_REG_LEN = 16;
-int const MAX_OP_LEN = 16;
-int const MAX_LABEL_LEN = 8;
+// a vreg is live over [start, end] in instruction positions.
+// instruction k uses its operands at 2k and defines its result at 2k+1
+struct Interval;
+typedef struct Interval Interval;
 
-char const* make_label() {
+struct Interval {
+  Vreg vreg;
+  int start;
+  int end;
+  bool crosses_call;
+};
+
+struct Emitter;
+typedef struct Emitter Emitter;
+
+struct Emitter {
+  Writer* out; // assembly, or NULL with object
+  Writer* comment; // scratch for write_ir_comment
+  ObjectFile* object; // every function goes here instead of out, or NULL
+  EmitOption option;
+  PeepholeStats stats; // over all functions
+
+  IrFunc const* func;
+  X86Func* code; // of func
+  Operand* homes; // indexed by vreg
+  unsigned callee_saved_used;
+  int slot_size; // bytes used by saved registers and spilled vregs
+  int label_base;
+  int* use_counts; // indexed by vreg
+  unsigned* call_saves; // caller-saved registers holding values across each call, in layout order
+  int* save_slots; // indexed by Reg. where call_saves are kept during a call
+  int call_index; // calls emitted so far
+  // the IR_EQ of the current block that only sets the flags for its IR_BR, or NULL
+  IrInst const* fused;
+};
+
+int make_label(int count) {
   static int cnt = 0;
-  char* const l = malloc(MAX_LABEL_LEN);
-  snprintf(l, MAX_LABEL_LEN, ".L%d", cnt++);
-  return l;
+  int const base = cnt;
+  cnt += count;
+  return base;
 }
 
-void save_regs(FILE* outfile, int argc, int depth) {
-  for(int i = 0; i < argc; ++i) {
-    int const offset = (depth + i) * 4;
-    fprintf(outfile, "\tmov %%%s, -%d(%%rbp)\n", REGS[i], offset);
+// "\t<op> <src>, <dst>\n"
+void emit_op2(Emitter* e, X86Op op, Operand src, Operand dst) {
+  X86Inst* const inst = append_X86Inst(e->code, op);
+  inst->src = src;
+  inst->dst = dst;
+}
+
+// for the ones writing their only operand
+void emit_op1(Emitter* e, X86Op op, Operand o) {
+  append_X86Inst(e->code, op)->dst = o;
+}
+
+void emit_mov(Emitter* e, Operand src, Operand dst) {
+  if(same_operand(src, dst)) {
+    return;
   }
+  assert(dst.type != IMM_OPERAND);
+  if(src.type == SLOT_OPERAND && dst.type == SLOT_OPERAND) {
+    emit_op2(e, X86_MOVL, src, reg_operand(RAX));
+    src = reg_operand(RAX);
+  }
+  emit_op2(e, X86_MOVL, src, dst);
 }
-void restore_regs(FILE* outfile, int argc, int depth) {
-  for(int i = 0; i < argc; ++i) {
-    int const offset = (depth + i) * 4;
-    fprintf(outfile, "\tmov -%d(%%rbp), %%%s\n", offset, REGS[i]);
-  }
-}
-
-void emit_int_to(FILE* outfile, Ast const* ast, char const* reg) {
-  fprintf(outfile, "\tmovl $%d, %s\n", ast->int_val, reg);
-}
-
-void emit_bi_op(FILE* outfile, Ast const* ast, Env const* env, int depth, char const* to) {
-  TokenType const t = ast->bi_op.op_type;
-  switch(t) {
-  case OP_PLUS_T:
-  case OP_MULTI_T:
-  case OP_EQUAL_T:
-  {
-    char const * const op = op_from_type(t);
-    char op_with_suffix[MAX_OP_LEN];
-    snprintf(op_with_suffix, MAX_OP_LEN, "%sl", op);
-    int const offset = depth * 4;
-    emit_ast_impl(outfile, ast->bi_op.lhs, env, depth + 1, NULL);
-    fprintf(outfile, "\tmov %%eax, -%d(%%rbp)\n", offset);
-    emit_ast_impl(outfile, ast->bi_op.rhs, env, depth + 2, NULL);
-    fprintf(outfile, "\t%s -%d(%%rbp), %%eax\n", op_with_suffix, offset);
-    if(t == OP_EQUAL_T) {
-      fprintf(outfile,
-              "\tsete %%al\n"
-              "\tmovzbl %%al, %%eax\n");
-    }
-    if(strcmp(to, "%eax")) {
-      fprintf(outfile, "\tmov %%eax, %s\n", to);
+
+Operand home(Emitter const* e, Vreg v) {
+  assert(0 <= v && v < e->func->vreg_count);
+  return e->homes[v];
+}
+
+void emit_label(Emitter* e, int block) {
+  append_X86Inst(e->code, X86_LABEL)->label = e->label_base + block;
+}
+
+// saves(store == true) or restores the callee-saved registers in use
+void emit_callee_saved(Emitter* e, bool store) {
+  int offset = 0;
+  for(int i = 0; i < NUMBER_OF_CALLEE_SAVED_REGS; ++i) {
+    Reg const r = CALLEE_SAVED_REGS[i];
+    if(e->callee_saved_used & REG_BIT(r)) {
+      offset += 8;
+      if(store) {
+        emit_op2(e, X86_MOVQ, reg_operand(r), slot_operand(offset));
+      } else {
+        emit_op2(e, X86_MOVQ, slot_operand(offset), reg_operand(r));
+      }
     }
-    break;
   }
-  case OP_MINUS_T:
-  {
-    int const offset = depth * 4;
-    emit_ast_impl(outfile, ast->bi_op.rhs, env, depth + 1, NULL);
-    fprintf(outfile, "\tmov %%eax, -%d(%%rbp)\n", offset);
-    emit_ast_impl(outfile, ast->bi_op.lhs, env, depth + 2, NULL);
-    fprintf(outfile, "\tsub -%d(%%rbp), %%eax\n", offset);
-    if(strcmp(to, "%eax")) {
-      fprintf(outfile, "\tmov %%eax, %s\n", to);
-    }
-    break;
+}
+
+void emit_prologue(Emitter* e) {
+  if(e->code->frame_pointer) {
+    append_X86Inst(e->code, X86_PUSHQ)->src = reg_operand(RBP);
+    emit_op2(e, X86_MOVQ, reg_operand(RSP), reg_operand(RBP));
   }
-  case OP_DIV_T:
-  {
-    int const offset = depth * 4;
-    emit_ast_impl(outfile, ast->bi_op.rhs, env, depth + 1, NULL);
-    fprintf(outfile, "\tmov %%eax, -%d(%%rbp)\n", offset);
-    emit_ast_impl(outfile, ast->bi_op.lhs, env, depth + 2, NULL);
-    fprintf(outfile, "\tcltd\n");
-    fprintf(outfile, "\tidivl -%d(%%rbp)\n", offset);
-    if(strcmp(to, "%eax")) {
-      fprintf(outfile, "\tmov %%eax, %s\n", to);
-    }
-    break;
+  if(e->code->frame_size != 0) {
+    emit_op2(e, X86_SUBQ, imm_operand(e->code->frame_size), reg_operand(RSP));
   }
-  case OP_ASSIGN_T:
-  {
-    char reg[MAX_REG_LEN];
-    snprintf(reg, MAX_REG_LEN, "-%d(%%rbp)", ast->bi_op.lhs->var->offset);
-    emit_ast_impl(outfile, ast->bi_op.rhs, env, depth + 1, reg);
-    break;
+  emit_callee_saved(e, true);
+}
+
+// back to the state on entry, with the return address on top
+void emit_leave(Emitter* e) {
+  emit_callee_saved(e, false);
+  if(e->code->frame_pointer) {
+    emit_op2(e, X86_MOVQ, reg_operand(RBP), reg_operand(RSP));
+    emit_op1(e, X86_POPQ, reg_operand(RBP));
+  } else if(e->code->frame_size != 0) {
+    emit_op2(e, X86_ADDQ, imm_operand(e->code->frame_size), reg_operand(RSP));
   }
+}
+
+void emit_epilogue(Emitter* e) {
+  emit_leave(e);
+  append_X86Inst(e->code, X86_RET);
+}
+
+// flags for a - b
+void emit_compare(Emitter* e, Operand a, Operand b) {
+  if(a.type != REG_OPERAND && b.type != REG_OPERAND) {
+    emit_mov(e, a, reg_operand(RAX));
+    a = reg_operand(RAX);
+  }
+  emit_op2(e, X86_CMPL, b, a);
+}
+
+void emit_binary(Emitter* e, IrInst const* inst) {
+  Operand const a = home(e, inst->a);
+  Operand const b = home(e, inst->b);
+  Operand const d = home(e, inst->dst);
+  if(inst->op == IR_DIV) {
+    // %eax/%edx are never allocated, so b is elsewhere
+    emit_mov(e, a, reg_operand(RAX));
+    append_X86Inst(e->code, X86_CLTD);
+    append_X86Inst(e->code, X86_IDIVL)->src = b;
+    emit_mov(e, reg_operand(RAX), d);
+    return;
+  }
+  // compute in place unless that overwrites b before it's read
+  Reg const r = d.type == REG_OPERAND && !same_operand(d, b) ? (Reg)d.val : RAX;
+  emit_mov(e, a, reg_operand(r));
+  switch(inst->op) {
+  case IR_ADD:
+    emit_op2(e, X86_ADDL, b, reg_operand(r));
+    break;
+  case IR_SUB:
+    emit_op2(e, X86_SUBL, b, reg_operand(r));
+    break;
+  case IR_MUL:
+    emit_op2(e, X86_IMULL, b, reg_operand(r));
+    break;
+  case IR_EQ:
+    emit_op2(e, X86_CMPL, b, reg_operand(r));
+    emit_op1(e, X86_SETE, reg_operand(r));
+    emit_op2(e, X86_MOVZBL, reg_operand(r), reg_operand(r));
+    break;
   default:
-    // never come
-    warn("unknown token type(%s)\n", show_TokenType(t));
+    warn("unknown binary op(%s)\n", show_IrOp(inst->op));
   }
+  emit_mov(e, reg_operand(r), d);
 }
 
-void emit_ast_impl(FILE* outfile, Ast const* ast, Env const* env, int depth, char const* to) {
-  if(to == NULL) { to = "%eax"; }
-  AstType const t = ast->type;
-  fprintf(outfile, "# begin of %s\n", show_AstType(t));
-  switch(t) {
-  case AST_INT:
-    emit_int_to(outfile, ast, to);
+void emit_unary(Emitter* e, IrInst const* inst) {
+  Operand const d = home(e, inst->dst);
+  Reg const r = d.type == REG_OPERAND ? (Reg)d.val : RAX;
+  emit_mov(e, home(e, inst->a), reg_operand(r));
+  switch(inst->op) {
+  case IR_NEG:
+    emit_op1(e, X86_NEGL, reg_operand(r));
     break;
-  case AST_BI_OP:
-    emit_bi_op(outfile, ast, env, depth, to);
+  case IR_SHL:
+    emit_op2(e, X86_SHLL, imm_operand(inst->imm), reg_operand(r));
     break;
-  case AST_SYM:
-    fprintf(outfile, "\tmov -%d(%%rbp), %s\n", ast->var->offset, to);
+  case IR_SAR:
+    emit_op2(e, X86_SARL, imm_operand(inst->imm), reg_operand(r));
     break;
-  case AST_SYM_DEFINE:
+  case IR_SHR:
+    emit_op2(e, X86_SHRL, imm_operand(inst->imm), reg_operand(r));
     break;
-  case AST_STATEMENT:
-    switch(ast->statement->type) {
-    case NORMAL_STATEMENT:
-      emit_ast_impl(outfile, ast->statement->val, env, depth, to);
-      break;
-    case RETURN_STATEMENT:
-      fprintf(outfile, "# return statement\n");
-      emit_ast_impl(outfile, ast->statement->val, env, depth, NULL);
-      fprintf(outfile, "\tmovq %%rbp, %%rsp\n");
-      fprintf(outfile, "\tpopq %%rbp\n");
-      fprintf(outfile, "\tret\n");
-      break;
-    case IF_STATEMENT:
-    {
-      char const* const join = make_label();
-      emit_ast_impl(outfile, ast->statement->if_val.cond, env, depth, NULL);
-      fprintf(outfile, "\tcmpl $0, %%eax\n");
-      if(ast->statement->if_val.else_body != NULL) {
-        char const* const else_l = make_label();
-        fprintf(outfile, "\tje %s\n", else_l);
-        emit_ast_impl(outfile, make_ast_statement(ast->statement->if_val.body), env, depth, NULL);
-        fprintf(outfile, "\tjmp %s\n", join);
-        fprintf(outfile, "%s:\n", else_l);
-        emit_ast_impl(outfile, make_ast_statement(ast->statement->if_val.else_body), env, depth, NULL);
+  default:
+    warn("unknown unary op(%s)\n", show_IrOp(inst->op));
+  }
+  emit_mov(e, reg_operand(r), d);
+}
+
+// dsts[i] = srcs[i] for all i at once. the dsts are distinct, and only
+// registers can be on a cycle(so no slot-to-slot move needs %eax meanwhile)
+void emit_parallel_move(Emitter* e, Operand* srcs, Operand const* dsts, int n) {
+  bool* const done = region_alloc(CODEGEN_REGION, sizeof(bool) * (n + 1));
+  int left = n;
+  for(int i = 0; i < n; ++i) {
+    done[i] = same_operand(srcs[i], dsts[i]);
+    left -= done[i];
+  }
+  while(left != 0) {
+    bool progress = false;
+    for(int i = 0; i < n; ++i) {
+      if(done[i]) {
+        continue;
+      }
+      bool blocked = false;
+      for(int j = 0; j < n; ++j) {
+        blocked = blocked || (!done[j] && j != i && same_operand(srcs[j], dsts[i]));
+      }
+      if(!blocked) {
+        emit_mov(e, srcs[i], dsts[i]);
+        done[i] = true;
+        --left;
+        progress = true;
+      }
+    }
+    if(!progress) {
+      // every move left reads another one's dst, so they form cycles
+      // and none reads %eax. one dst is kept there until it's read
+      int i = 0;
+      while(done[i]) {
+        ++i;
+      }
+      emit_mov(e, dsts[i], reg_operand(RAX));
+      for(int j = 0; j < n; ++j) {
+        if(!done[j] && same_operand(srcs[j], dsts[i])) {
+          srcs[j] = reg_operand(RAX);
+        }
+      }
+    }
+  }
+}
+
+void emit_arguments(Emitter* e, IrInst const* inst) {
+  int const argc = inst->call.argc;
+  Operand* const srcs = region_alloc(CODEGEN_REGION, sizeof(Operand) * (argc + 1));
+  Operand* const dsts = region_alloc(CODEGEN_REGION, sizeof(Operand) * (argc + 1));
+  for(int i = 0; i < argc; ++i) {
+    srcs[i] = home(e, IrInst_use(e->func, inst, i));
+    dsts[i] = reg_operand(REGS[i]);
+  }
+  emit_parallel_move(e, srcs, dsts, argc);
+}
+
+void write_ir_comment(Emitter* e, IrInst const* inst) {
+  if(e->option.ir_comment) {
+    reset_Writer(e->comment);
+    write_IrInst(e->comment, e->func, inst);
+    char* const text = region_alloc(CODEGEN_REGION, e->comment->length + 1);
+    memcpy(text, e->comment->buf, e->comment->length);
+    text[e->comment->length] = '\0';
+    append_X86Inst(e->code, X86_COMMENT)->comment = text;
+  }
+}
+
+// the IR_PARAMs of the entry block, all at once before anything else
+void emit_params(Emitter* e) {
+  IrBlock const* const b = &e->func->blocks[0];
+  Operand* const srcs = region_alloc(CODEGEN_REGION, sizeof(Operand) * (b->count + 1));
+  Operand* const dsts = region_alloc(CODEGEN_REGION, sizeof(Operand) * (b->count + 1));
+  int n = 0;
+  for(int j = 0; j < b->count; ++j) {
+    IrInst const* const inst = &b->insts[j];
+    if(inst->op != IR_PARAM) {
+      continue;
+    }
+    if(inst->imm >= 6) {
+      warn("argc over 6 is not impled now");
+      continue;
+    }
+    write_ir_comment(e, inst);
+    srcs[n] = reg_operand(REGS[inst->imm]);
+    dsts[n] = home(e, inst->dst);
+    ++n;
+  }
+  emit_parallel_move(e, srcs, dsts, n);
+}
+
+// saves(store == true) or restores the caller-saved registers live across the call
+void write_call_saves(Emitter* e, unsigned saves, bool store) {
+  for(Reg r = 0; r < NUMBER_OF_REGS; ++r) {
+    if(saves & REG_BIT(r)) {
+      if(store) {
+        emit_mov(e, reg_operand(r), slot_operand(e->save_slots[r]));
       } else {
-        fprintf(outfile, "\tje %s\n", join);
-        emit_ast_impl(outfile, make_ast_statement(ast->statement->if_val.body), env, depth, NULL);
+        emit_mov(e, slot_operand(e->save_slots[r]), reg_operand(r));
       }
-      fprintf(outfile, "%s:\n", join);
-      break;
     }
-    case WHILE_STATEMENT:
-    {
-      char const* const init = make_label();
-      char const* const join = make_label();
-      fprintf(outfile, "%s:\n", init);
-      emit_ast_impl(outfile, ast->statement->while_val.cond, env, depth, NULL);
-      fprintf(outfile, "\tcmpl $0, %%eax\n");
-      fprintf(outfile, "\tje %s\n", join);
-      emit_ast_impl(outfile, make_ast_statement(ast->statement->if_val.body), env, depth, NULL);
-      fprintf(outfile, "\tjmp %s\n", init);
-      fprintf(outfile, "%s:\n", join);
+  }
+}
+
+void emit_call(Emitter* e, IrInst const* inst) {
+  unsigned const saves = e->call_saves[e->call_index++];
+  if(inst->call.argc > 6) {
+    warn("argc over 6 is not impled now");
+    return;
+  }
+  write_call_saves(e, saves, true);
+  emit_arguments(e, inst);
+  X86Inst* const call = append_X86Inst(e->code, X86_CALL);
+  call->call.name = inst->name;
+  call->call.argc = inst->call.argc;
+  write_call_saves(e, saves, false);
+  emit_mov(e, reg_operand(RAX), home(e, inst->dst));
+}
+
+void emit_jump(Emitter* e, X86Op op, int target) {
+  append_X86Inst(e->code, op)->label = e->label_base + target;
+}
+
+// jumps to target[0] if the flags say jcc_true, to target[1] otherwise
+void emit_branch(Emitter* e, int block, IrInst const* inst, X86Op jcc_true, X86Op jcc_false) {
+  if(inst->target[0] == block + 1) {
+    emit_jump(e, jcc_false, inst->target[1]);
+    return;
+  }
+  emit_jump(e, jcc_true, inst->target[0]);
+  if(inst->target[1] != block + 1) {
+    emit_jump(e, X86_JMP, inst->target[1]);
+  }
+}
+
+// `call; ret` of its result: the callee returns straight to our caller
+bool is_tail_call(Emitter const* e, IrBlock const* b, int index) {
+  IrInst const* const inst = &b->insts[index];
+  if(!e->option.tail_calls || inst->op != IR_CALL || inst->call.argc > 6) {
+    return false;
+  }
+  IrInst const* const next = &b->insts[index + 1];
+  return next->op == IR_RET && (next->a == NO_VREG || next->a == inst->dst);
+}
+
+void emit_tail_call(Emitter* e, IrInst const* inst) {
+  ++e->call_index;
+  emit_arguments(e, inst);
+  emit_leave(e);
+  X86Inst* const jmp = append_X86Inst(e->code, X86_TAIL);
+  jmp->call.name = inst->name;
+  jmp->call.argc = inst->call.argc;
+}
+
+void emit_inst(Emitter* e, int block, IrInst const* inst) {
+  if(inst->op != IR_PARAM) {
+    write_ir_comment(e, inst);
+  }
+  switch(inst->op) {
+  case IR_CONST:
+    emit_mov(e, imm_operand(inst->imm), home(e, inst->dst));
+    break;
+  case IR_PARAM:
+    // done by emit_params
+    break;
+  case IR_MOV:
+    emit_mov(e, home(e, inst->a), home(e, inst->dst));
+    break;
+  case IR_EQ:
+    if(inst == e->fused) {
+      emit_compare(e, home(e, inst->a), home(e, inst->b));
       break;
     }
-    default:
-      warn("unimpled statement type(%s)\n", show_StatementType(ast->statement->type));
+    emit_binary(e, inst);
+    break;
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+    emit_binary(e, inst);
+    break;
+  case IR_NEG:
+  case IR_SHL:
+  case IR_SAR:
+  case IR_SHR:
+    emit_unary(e, inst);
+    break;
+  case IR_CALL:
+    emit_call(e, inst);
+    break;
+  case IR_JMP:
+    if(inst->target[0] != block + 1) {
+      emit_jump(e, X86_JMP, inst->target[0]);
     }
     break;
-  case AST_STATEMENTS:
-    FOREACH(Statement, ast->statements->val, s) {
-      emit_ast_impl(outfile, make_ast_statement(s), env, depth + 1, NULL);
+  case IR_BR:
+    if(e->fused != NULL && e->fused->dst == inst->a) {
+      emit_branch(e, block, inst, X86_JE, X86_JNE);
+    } else {
+      emit_op2(e, X86_CMPL, imm_operand(0), home(e, inst->a));
+      emit_branch(e, block, inst, X86_JNE, X86_JE);
     }
-    if(strcmp(to, "%eax")) {
-      fprintf(outfile, "\tmov %%eax, %s\n", to);
+    break;
+  case IR_RET:
+    if(inst->a != NO_VREG) {
+      emit_mov(e, home(e, inst->a), reg_operand(RAX));
     }
+    emit_epilogue(e);
     break;
-  case AST_FUNCALL:
-  {
-    int const argc = ast->funcall->argc;
-    char const* const name = ast->funcall->name;
-    if(argc > 6) {
-      warn("argc over 6 is not impled now");
-      break;
+  case IR_NOP:
+    break;
+  case IR_PHI:
+    warn("phi is left(leave_ssa wasn't run)\n");
+    break;
+  }
+}
+
+void extend(Interval* interval, int pos) {
+  if(pos < interval->start) {
+    interval->start = pos;
+  }
+  if(pos > interval->end) {
+    interval->end = pos;
+  }
+}
+
+// one interval per vreg, covering everywhere it's live(no holes)
+Interval* build_intervals(IrFunc const* f, int** call_positions, int* call_count) {
+  Liveness const* const live = compute_Liveness(f);
+  Interval* const intervals = region_alloc(CODEGEN_REGION, sizeof(Interval) * (f->vreg_count + 1));
+  for(int v = 0; v < f->vreg_count; ++v) {
+    intervals[v].vreg = v;
+    intervals[v].start = INT_MAX;
+    intervals[v].end = INT_MIN;
+    intervals[v].crosses_call = false;
+  }
+  *call_positions = region_alloc(CODEGEN_REGION, sizeof(int) * (IrFunc_inst_count(f) + 1));
+  *call_count = 0;
+  int pos = 0;
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    int const block_start = pos;
+    int const block_end = pos + b->count * 2 - 1;
+    for(int v = 0; v < f->vreg_count; ++v) {
+      // live before the first instruction, which may be a call
+      if(BitSet_has(live->live_in[i], v)) {
+        extend(&intervals[v], block_start - 1);
+      }
+      if(BitSet_has(live->live_out[i], v)) {
+        extend(&intervals[v], block_end);
+      }
+    }
+    for(int j = 0; j < b->count; ++j, pos += 2) {
+      IrInst const* const inst = &b->insts[j];
+      for(int k = 0; k < IrInst_use_count(inst); ++k) {
+        extend(&intervals[IrInst_use(f, inst, k)], pos);
+      }
+      if(inst->dst != NO_VREG) {
+        // emit_params defines them before everything else
+        extend(&intervals[inst->dst], inst->op == IR_PARAM ? -1 : pos + 1);
+      }
+      if(inst->op == IR_CALL) {
+        (*call_positions)[(*call_count)++] = pos;
+      }
+    }
+  }
+  for(int v = 0; v < f->vreg_count; ++v) {
+    Interval* const interval = &intervals[v];
+    for(int i = 0; i < *call_count; ++i) {
+      int const p = (*call_positions)[i];
+      if(interval->start < p && interval->end > p + 1) {
+        interval->crosses_call = true;
+        break;
+      }
+    }
+  }
+  return intervals;
+}
+
+int compare_Interval_start(void const* lhs, void const* rhs) {
+  Interval const* const l = *(Interval const* const*)lhs;
+  Interval const* const r = *(Interval const* const*)rhs;
+  return l->start != r->start ? (l->start < r->start ? -1 : 1) : l->vreg - r->vreg;
+}
+
+int lowest_reg(unsigned mask) {
+  assert(mask != 0);
+  return __builtin_ctz(mask);
+}
+
+// gives the spilled intervals 4-byte slots below the saved registers(which take base bytes).
+// intervals that don't overlap share a slot. order is sorted by start.
+// returns the bytes used
+int layout_spill_slots(Emitter* e, Interval* const* order, int n, int base) {
+  int* const slot_end = region_alloc(CODEGEN_REGION, sizeof(int) * (n + 1)); // last use of each slot's value
+  int slot_count = 0;
+  for(int i = 0; i < n; ++i) {
+    Interval const* const cur = order[i];
+    if(e->homes[cur->vreg].type != SLOT_OPERAND) {
+      continue;
     }
-    save_regs(outfile, argc, depth + 1);
-    for(int i = 0; i < argc; ++i) {
-      Ast* const arg = ast->funcall->args[i];
-      if(arg->type == AST_INT) {
-        char reg[MAX_REG_LEN];
-        snprintf(reg, MAX_REG_LEN, "%%%s", REGS[i]);
-        emit_int_to(outfile, arg, reg);
+    int slot = 0;
+    while(slot < slot_count && slot_end[slot] >= cur->start) {
+      ++slot;
+    }
+    if(slot == slot_count) {
+      ++slot_count;
+    }
+    slot_end[slot] = cur->end;
+    e->homes[cur->vreg] = slot_operand(base + 4 * (slot + 1));
+  }
+  return base + 4 * slot_count;
+}
+
+// linear scan. values living across a call get callee-saved registers
+void allocate_registers(Emitter* e) {
+  IrFunc const* const f = e->func;
+  int* call_positions;
+  int call_count;
+  Interval* const intervals = build_intervals(f, &call_positions, &call_count);
+
+  int n = 0;
+  Interval** const order = region_alloc(CODEGEN_REGION, sizeof(Interval*) * (f->vreg_count + 1));
+  for(int v = 0; v < f->vreg_count; ++v) {
+    e->homes[v] = slot_operand(0);
+    if(intervals[v].start <= intervals[v].end) {
+      order[n++] = &intervals[v];
+    }
+  }
+  qsort(order, n, sizeof(Interval*), compare_Interval_start);
+
+  Interval** const active = region_alloc(CODEGEN_REGION, sizeof(Interval*) * (n + 1));
+  int active_count = 0;
+  unsigned free_regs = ALLOCATABLE_MASK;
+  for(int i = 0; i < n; ++i) {
+    Interval* const cur = order[i];
+    int k = 0;
+    for(int j = 0; j < active_count; ++j) {
+      if(active[j]->end < cur->start) {
+        free_regs |= REG_BIT(e->homes[active[j]->vreg].val);
       } else {
-        emit_ast_impl(outfile, arg, env, depth+7, NULL);
-        fprintf(outfile, "\tmov %%eax, %%%s\n", REGS[i]);
+        active[k++] = active[j];
       }
     }
-    fprintf(outfile, "\tcall %s\n", name);
-    if(strcmp(to, "%eax")) {
-      fprintf(outfile, "\tmov %%eax, %s\n", to);
+    active_count = k;
+    unsigned const candidates = free_regs;
+    if(candidates != 0) {
+      // caller-saved ones first, to keep prologues short. values living across
+      // a call prefer callee-saved ones, or are saved around the call(emit_call)
+      unsigned const preferred = candidates & (cur->crosses_call ? CALLEE_SAVED_MASK : ~CALLEE_SAVED_MASK);
+      Reg const r = lowest_reg(preferred != 0 ? preferred : candidates);
+      free_regs &= ~REG_BIT(r);
+      e->homes[cur->vreg] = reg_operand(r);
+      active[active_count++] = cur;
+      continue;
+    }
+    // spill whichever ends last
+    int last = -1;
+    for(int j = 0; j < active_count; ++j) {
+      if(last < 0 || active[j]->end > active[last]->end) {
+        last = j;
+      }
+    }
+    if(last >= 0 && active[last]->end > cur->end) {
+      e->homes[cur->vreg] = e->homes[active[last]->vreg];
+      e->homes[active[last]->vreg] = slot_operand(0);
+      active[last] = cur;
     }
-    restore_regs(outfile, argc, depth + 1);
-    break;
   }
-  case AST_BLOCK:
-    emit_ast_impl(outfile, ast->block->val, env, depth, to);
-    break;
-  default:
-    warn("never come!!!(type: %s)\n", show_AstType(t));
-    break;
+
+  e->callee_saved_used = 0;
+  for(int v = 0; v < f->vreg_count; ++v) {
+    if(e->homes[v].type == REG_OPERAND) {
+      e->callee_saved_used |= REG_BIT(e->homes[v].val) & CALLEE_SAVED_MASK;
+    }
+  }
+  int offset = layout_spill_slots(e, order, n, 8 * __builtin_popcount(e->callee_saved_used));
+
+  e->call_saves = region_alloc(CODEGEN_REGION, sizeof(unsigned) * (call_count + 1));
+  unsigned saved = 0;
+  for(int i = 0; i < call_count; ++i) {
+    int const p = call_positions[i];
+    e->call_saves[i] = 0;
+    for(int v = 0; v < f->vreg_count; ++v) {
+      Operand const h = e->homes[v];
+      if(h.type == REG_OPERAND && intervals[v].start < p && intervals[v].end > p + 1) {
+        e->call_saves[i] |= REG_BIT(h.val) & ~CALLEE_SAVED_MASK;
+      }
+    }
+    saved |= e->call_saves[i];
   }
-  fprintf(outfile, "# end of %s\n", show_AstType(t));
+  e->save_slots = region_alloc(CODEGEN_REGION, sizeof(int) * NUMBER_OF_REGS);
+  for(Reg r = 0; r < NUMBER_OF_REGS; ++r) {
+    if(saved & REG_BIT(r)) {
+      offset += 4;
+      e->save_slots[r] = offset;
+    }
+  }
+  e->slot_size = offset;
 }
 
-void emit_ast(FILE* outfile, Ast const* ast, Env const* env, int depth) {
-  emit_ast_impl(outfile, ast, env, depth, NULL);
+// the IR_EQ whose only use is the IR_BR ending b, with nothing but moves
+// (which keep the flags) between them. its result is never materialized
+IrInst const* fused_compare(Emitter const* e, IrBlock const* b) {
+  IrInst const* const br = IrBlock_terminator(b);
+  if(br->op != IR_BR || e->use_counts[br->a] != 1) {
+    return NULL;
+  }
+  for(int j = b->count - 2; j >= 0; --j) {
+    IrInst const* const inst = &b->insts[j];
+    if(inst->dst == br->a) {
+      return inst->op == IR_EQ ? inst : NULL;
+    }
+    if(inst->op != IR_MOV) {
+      return NULL;
+    }
+  }
+  return NULL;
 }
 
 int round16(int n) {
@@ -215,42 +624,112 @@ int round16(int n) {
   return (n / 16 + 1) * 16;
 }
 
-void assign_parameter(FILE* outfile, int argn, Var** args) {
-  char const* const reg = REGS[argn];
-  fprintf(outfile, "\tmov %%%s, -%d(%%rbp)\n", reg, args[argn]->offset);
-}
-
-void emit_func(FILE* outfile, Ast const* ast, Env const* env) {
-  assert(ast != NULL);
-  assert(ast->type == AST_FUNDEFIN);
-  FunDef const* const func = ast->fundef;
-  int const var_cnt = var_count(env) + 1;
-  int const stack = round16(var_cnt * 4);
-  fprintf(
-    outfile,
-    "\t.global %s\n"
-    "%s:\n"
-    "\tpushq %%rbp\n"
-    "\tmovq %%rsp, %%rbp\n"
-    "\tsubq $%d, %%rsp\n"
-    , func->name
-    , func->name
-    , stack
-  );
-  for(int i = 0; i < func->type.argc; ++i) {
-    assign_parameter(outfile, i, func->args);
-  }
-  emit_ast(outfile, func->body, env, var_cnt + func->type.argc);
-  fprintf(outfile, "\tmovq %%rbp, %%rsp\n");
-  fprintf(outfile, "\tpopq %%rbp\n");
-  fprintf(outfile, "\tret\n");
-}
-
-void emit(FILE* outfile, Ast const* ast, Env const* env) {
-  assert(ast != NULL);
-  assert(ast->type == AST_GLOBAL);
-  fprintf(outfile, "\t.text\n");
-  FOREACH(Ast, ast->global->list, s) {
-    emit_func(outfile, s, env);
+int const RED_ZONE_SIZE = 128;
+
+// tail calls don't count: they leave the frame before jumping
+bool makes_call(Emitter const* e) {
+  IrFunc const* const f = e->func;
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      if(b->insts[j].op == IR_CALL && !is_tail_call(e, b, j)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// a leaf function whose slots fit in the red zone needs no frame at all.
+// %rsp is 16-byte aligned at calls: it's 8 off on entry, and pushq %rbp fixes that
+void layout_frame(Emitter* e) {
+  X86Func* const code = e->code;
+  if(!makes_call(e) && e->slot_size <= RED_ZONE_SIZE) {
+    code->frame_pointer = false;
+    code->frame_size = 0;
+  } else if(e->option.omit_frame_pointer) {
+    code->frame_pointer = false;
+    code->frame_size = round16(e->slot_size + 8) - 8;
+  } else {
+    code->frame_pointer = true;
+    code->frame_size = round16(e->slot_size);
+  }
+}
+
+void emit_func(Emitter* e, IrFunc const* f) {
+  e->func = f;
+  e->code = new_X86Func(f->name);
+  e->homes = region_alloc(CODEGEN_REGION, sizeof(Operand) * (f->vreg_count + 1));
+  e->label_base = make_label(f->block_count);
+  allocate_registers(e);
+  layout_frame(e);
+  e->use_counts = region_alloc(CODEGEN_REGION, sizeof(int) * (f->vreg_count + 1));
+  memset(e->use_counts, 0, sizeof(int) * (f->vreg_count + 1));
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      for(int k = 0; k < IrInst_use_count(&b->insts[j]); ++k) {
+        ++e->use_counts[IrInst_use(f, &b->insts[j], k)];
+      }
+    }
+  }
+
+  e->call_index = 0;
+  emit_prologue(e);
+  emit_params(e);
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    e->fused = fused_compare(e, b);
+    if(i != 0) {
+      emit_label(e, i);
+    }
+    for(int j = 0; j < b->count; ++j) {
+      if(is_tail_call(e, b, j)) {
+        write_ir_comment(e, &b->insts[j]);
+        write_ir_comment(e, &b->insts[j + 1]);
+        emit_tail_call(e, &b->insts[j]);
+        break;
+      }
+      emit_inst(e, i, &b->insts[j]);
+    }
+  }
+
+  if(e->option.peephole) {
+    peephole(e->code, &e->stats);
+  }
+  if(e->object != NULL) {
+    encode_X86Func(e->object, e->code);
+  } else {
+    write_X86Func(e->out, e->code);
+  }
+}
+
+// every function of program, as assembly to out or encoded into object
+void emit_program(Writer* out, ObjectFile* object, IrProgram const* program, EmitOption const* option) {
+  assert(program != NULL);
+  Emitter emitter = { out, new_buffer_Writer(), object, *option, { { 0 } }, NULL, NULL, NULL, 0, 0, 0, NULL, NULL, NULL, 0, NULL };
+  Emitter* const e = &emitter;
+  for(int i = 0; i < program->count; ++i) {
+    emit_func(e, &program->funcs[i]);
+  }
+  if(option->peephole && option->peephole_report) {
+    print_PeepholeStats(stderr, &e->stats);
+  }
+}
+
+ObjectFile* emit_object(IrProgram const* program, EmitOption const* option) {
+  ObjectFile* const object = new_ObjectFile();
+  emit_program(NULL, object, program, option);
+  return object;
+}
+
+void emit(FILE* outfile, IrProgram const* program, EmitOption const* option) {
+  Writer* const out = new_Writer(outfile);
+  if(option->object) {
+    write_ObjectFile(out, emit_object(program, option));
+  } else {
+    writef(out, "\t.text\n");
+    emit_program(out, NULL, program, option);
   }
+  flush_Writer(out);
 }
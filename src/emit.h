@@ -2,8 +2,24 @@
 #define NNA774_KONOHA_EMIT_H
 
 #include <stdio.h>
-#include "ast.h"
+#include "ir.h"
+#include "object.h"
 
-void emit(FILE* outfile, Ast const* ast, Env const* env);
+struct EmitOption;
+typedef struct EmitOption EmitOption;
+
+struct EmitOption {
+  bool ir_comment; // -g: each IR instruction as a comment before its code
+  bool omit_frame_pointer; // -fomit-frame-pointer: no %rbp frame, slots are addressed off %rsp
+  bool tail_calls; // from -O1: `call f; ret` becomes `jmp f`
+  bool peephole; // from -O1: the peephole pass over each function's instructions
+  bool peephole_report; // -v: how often each peephole pattern hit, to stderr
+  bool object; // -c: a relocatable ELF64 object instead of assembly
+};
+
+// x86-64 assembly(AT&T syntax), or an object file with option->object
+void emit(FILE* outfile, IrProgram const* program, EmitOption const* option);
+// the code of program as an object file in memory(whatever option->object says)
+ObjectFile* emit_object(IrProgram const* program, EmitOption const* option);
 
 #endif // NNA774_KONOHA_EMIT_H
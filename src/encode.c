@@ -0,0 +1,285 @@
+#include "arena.h"
+#include "encode.h"
+
+// a rel32 in .text waiting for the offset of label
+struct Fixup;
+typedef struct Fixup Fixup;
+
+struct Fixup {
+  int offset;
+  int label;
+};
+
+struct Encoder;
+typedef struct Encoder Encoder;
+
+struct Encoder {
+  ObjectFile* obj;
+  X86Func const* func;
+  Writer* text;
+  int label_base;
+  int* label_offsets; // indexed by label - label_base. -1 until it's bound
+  Fixup* fixups;
+  int fixup_count;
+  int fixup_capacity;
+};
+
+int position(Encoder const* e) {
+  return e->text->length;
+}
+
+void put_byte(Encoder* e, int b) {
+  write_char(e->text, (char)b);
+}
+
+void put_imm32(Encoder* e, int n) {
+  unsigned const u = n;
+  for(int i = 0; i < 4; ++i) {
+    put_byte(e, (u >> (8 * i)) & 0xff);
+  }
+}
+
+void patch_imm32(Encoder* e, int offset, int n) {
+  unsigned const u = n;
+  for(int i = 0; i < 4; ++i) {
+    e->text->buf[offset + i] = (u >> (8 * i)) & 0xff;
+  }
+}
+
+bool fits_int8(int n) {
+  return -128 <= n && n <= 127;
+}
+
+// opcode is one byte, or two with 0x0f first(0x0fxx).
+// reg is a register or the opcode extension(/digit) of the ModRM byte
+void put_rm(Encoder* e, bool w, int opcode, int reg, Operand rm) {
+  int const base = rm.type == REG_OPERAND ? rm.val : (int)slot_base(e->func);
+  int const rex = 0x40 | w << 3 | (reg >> 3 & 1) << 2 | (base >> 3 & 1);
+  if(rex != 0x40) {
+    put_byte(e, rex);
+  }
+  if(opcode > 0xff) {
+    put_byte(e, opcode >> 8);
+  }
+  put_byte(e, opcode & 0xff);
+  if(rm.type == REG_OPERAND) {
+    put_byte(e, 0xc0 | (reg & 7) << 3 | (base & 7));
+    return;
+  }
+  assert(rm.type == SLOT_OPERAND);
+  // always with a displacement, since %rbp has no form without one
+  int const disp = slot_displacement(e->func, rm.val);
+  put_byte(e, (fits_int8(disp) ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7));
+  if(base == RSP) {
+    put_byte(e, 0x24); // SIB: no index
+  }
+  if(fits_int8(disp)) {
+    put_byte(e, disp & 0xff);
+  } else {
+    put_imm32(e, disp);
+  }
+}
+
+// %spl, %bpl, %sil and %dil exist only with a REX prefix(without one they are %ah to %bh)
+void put_byte_rm(Encoder* e, int opcode, int reg, Operand rm) {
+  if(rm.type == REG_OPERAND && RSP <= rm.val && rm.val <= RDI && reg < 8) {
+    put_byte(e, 0x40);
+  }
+  put_rm(e, false, opcode, reg, rm);
+}
+
+// op r/m, imm with the short immediate form when it fits
+void put_rm_imm(Encoder* e, bool w, int ext, Operand rm, int imm) {
+  if(fits_int8(imm)) {
+    put_rm(e, w, 0x83, ext, rm);
+    put_byte(e, imm & 0xff);
+  } else {
+    put_rm(e, w, 0x81, ext, rm);
+    put_imm32(e, imm);
+  }
+}
+
+// add, sub and cmp. mr is the opcode of `op r/m, reg`, and mr + 2 that of `op reg, r/m`
+void encode_arith(Encoder* e, X86Inst const* inst, bool w, int ext, int mr) {
+  if(inst->src.type == IMM_OPERAND) {
+    put_rm_imm(e, w, ext, inst->dst, inst->src.val);
+  } else if(inst->src.type == REG_OPERAND) {
+    put_rm(e, w, mr, inst->src.val, inst->dst);
+  } else {
+    assert(inst->dst.type == REG_OPERAND);
+    put_rm(e, w, mr + 2, inst->dst.val, inst->src);
+  }
+}
+
+void encode_mov(Encoder* e, X86Inst const* inst, bool w) {
+  if(inst->src.type == IMM_OPERAND) {
+    assert(!w);
+    if(inst->dst.type == REG_OPERAND) {
+      if(inst->dst.val >= 8) {
+        put_byte(e, 0x41);
+      }
+      put_byte(e, 0xb8 + (inst->dst.val & 7));
+    } else {
+      put_rm(e, false, 0xc7, 0, inst->dst);
+    }
+    put_imm32(e, inst->src.val);
+  } else if(inst->src.type == REG_OPERAND) {
+    put_rm(e, w, 0x89, inst->src.val, inst->dst);
+  } else {
+    assert(inst->dst.type == REG_OPERAND);
+    put_rm(e, w, 0x8b, inst->dst.val, inst->src);
+  }
+}
+
+void encode_imul(Encoder* e, X86Inst const* inst) {
+  assert(inst->dst.type == REG_OPERAND);
+  if(inst->src.type != IMM_OPERAND) {
+    put_rm(e, false, 0x0faf, inst->dst.val, inst->src);
+  } else if(fits_int8(inst->src.val)) {
+    put_rm(e, false, 0x6b, inst->dst.val, inst->dst);
+    put_byte(e, inst->src.val & 0xff);
+  } else {
+    put_rm(e, false, 0x69, inst->dst.val, inst->dst);
+    put_imm32(e, inst->src.val);
+  }
+}
+
+// push and pop of a register
+void put_plus_reg(Encoder* e, int opcode, Operand o) {
+  assert(o.type == REG_OPERAND);
+  if(o.val >= 8) {
+    put_byte(e, 0x41);
+  }
+  put_byte(e, opcode + (o.val & 7));
+}
+
+void encode_call(Encoder* e, int opcode, Symbol name, int argc) {
+  put_byte(e, opcode);
+  add_Relocation(e->obj, position(e), name, argc);
+  put_imm32(e, 0);
+}
+
+// backward jumps that reach take 2 bytes. forward ones are always rel32:
+// their targets aren't known yet
+void encode_jump(Encoder* e, X86Op op, int label) {
+  int const target = e->label_offsets[label - e->label_base];
+  int const short_opcode = op == X86_JMP ? 0xeb : op == X86_JE ? 0x74 : 0x75;
+  if(target >= 0 && fits_int8(target - (position(e) + 2))) {
+    put_byte(e, short_opcode);
+    put_byte(e, (target - (position(e) + 1)) & 0xff);
+    return;
+  }
+  if(op == X86_JMP) {
+    put_byte(e, 0xe9);
+  } else {
+    put_byte(e, 0x0f);
+    put_byte(e, short_opcode + 0x10);
+  }
+  GROW_ARRAY(Fixup, e->fixups, e->fixup_count, e->fixup_capacity, 16);
+  Fixup* const fixup = &e->fixups[e->fixup_count++];
+  fixup->offset = position(e);
+  fixup->label = label;
+  put_imm32(e, 0);
+}
+
+void encode_inst(Encoder* e, X86Inst const* inst) {
+  switch(inst->op) {
+  case X86_MOVL:
+  case X86_MOVQ:
+    encode_mov(e, inst, inst->op == X86_MOVQ);
+    break;
+  case X86_ADDL:
+  case X86_ADDQ:
+    encode_arith(e, inst, inst->op == X86_ADDQ, 0, 0x01);
+    break;
+  case X86_SUBL:
+  case X86_SUBQ:
+    encode_arith(e, inst, inst->op == X86_SUBQ, 5, 0x29);
+    break;
+  case X86_CMPL:
+    encode_arith(e, inst, false, 7, 0x39);
+    break;
+  case X86_IMULL:
+    encode_imul(e, inst);
+    break;
+  case X86_SHLL:
+  case X86_SARL:
+  case X86_SHRL:
+    put_rm(e, false, 0xc1, inst->op == X86_SHLL ? 4 : inst->op == X86_SARL ? 7 : 5, inst->dst);
+    put_byte(e, inst->src.val & 0xff);
+    break;
+  case X86_NEGL:
+    put_rm(e, false, 0xf7, 3, inst->dst);
+    break;
+  case X86_CLTD:
+    put_byte(e, 0x99);
+    break;
+  case X86_IDIVL:
+    put_rm(e, false, 0xf7, 7, inst->src);
+    break;
+  case X86_SETE:
+    put_byte_rm(e, 0x0f94, 0, inst->dst);
+    break;
+  case X86_MOVZBL:
+    put_byte_rm(e, 0x0fb6, inst->dst.val, inst->src);
+    break;
+  case X86_PUSHQ:
+    put_plus_reg(e, 0x50, inst->src);
+    break;
+  case X86_POPQ:
+    put_plus_reg(e, 0x58, inst->dst);
+    break;
+  case X86_CALL:
+    encode_call(e, 0xe8, inst->call.name, inst->call.argc);
+    break;
+  case X86_TAIL:
+    encode_call(e, 0xe9, inst->call.name, inst->call.argc);
+    break;
+  case X86_RET:
+    put_byte(e, 0xc3);
+    break;
+  case X86_JMP:
+  case X86_JE:
+  case X86_JNE:
+    encode_jump(e, inst->op, inst->label);
+    break;
+  case X86_LABEL:
+    e->label_offsets[inst->label - e->label_base] = position(e);
+    break;
+  case X86_COMMENT:
+  case X86_NOP:
+    break;
+  }
+}
+
+void encode_X86Func(ObjectFile* obj, X86Func const* f) {
+  Encoder encoder = { obj, f, obj->text, 0, NULL, NULL, 0, 0 };
+  Encoder* const e = &encoder;
+  int max_label = -1;
+  for(int i = 0; i < f->count; ++i) {
+    X86Inst const* const inst = &f->insts[i];
+    if(inst->op == X86_LABEL || is_jump(inst->op)) {
+      if(max_label < 0 || inst->label < e->label_base) {
+        e->label_base = inst->label;
+      }
+      max_label = inst->label > max_label ? inst->label : max_label;
+    }
+  }
+  int const label_count = max_label < 0 ? 0 : max_label - e->label_base + 1;
+  e->label_offsets = region_alloc(CODEGEN_REGION, sizeof(int) * (label_count + 1));
+  for(int i = 0; i < label_count; ++i) {
+    e->label_offsets[i] = -1;
+  }
+
+  int const start = position(e);
+  for(int i = 0; i < f->count; ++i) {
+    encode_inst(e, &f->insts[i]);
+  }
+  for(int i = 0; i < e->fixup_count; ++i) {
+    Fixup const* const fixup = &e->fixups[i];
+    int const target = e->label_offsets[fixup->label - e->label_base];
+    assert(target >= 0);
+    patch_imm32(e, fixup->offset, target - (fixup->offset + 4));
+  }
+  define_ObjectSymbol(obj, f->name, start, position(e) - start);
+}
@@ -0,0 +1,11 @@
+#ifndef NNA774_KONOHA_ENCODE_H
+#define NNA774_KONOHA_ENCODE_H
+
+#include "object.h"
+#include "x86.h"
+
+// appends the machine code of f to obj's .text, with a symbol for f and
+// relocations for its calls. jumps to its labels are resolved here
+void encode_X86Func(ObjectFile* obj, X86Func const* f);
+
+#endif // NNA774_KONOHA_ENCODE_H
@@ -0,0 +1,174 @@
+#include <limits.h>
+#include "fold.h"
+
+// no side effects and no trap, so dropping it changes nothing
+bool is_pure_ast(Ast const* ast) {
+  switch(ast->type) {
+  case AST_INT:
+  case AST_SYM:
+    return true;
+  case AST_BI_OP:
+  {
+    TokenType const t = ast->bi_op.op_type;
+    if(t == OP_ASSIGN_T || t == OP_DIV_T) {
+      return false;
+    }
+    return is_pure_ast(ast->bi_op.lhs) && is_pure_ast(ast->bi_op.rhs);
+  }
+  default:
+    return false;
+  }
+}
+
+bool same_ast(Ast const* x, Ast const* y) {
+  if(x->type != y->type) {
+    return false;
+  }
+  switch(x->type) {
+  case AST_INT:
+    return x->int_val == y->int_val;
+  case AST_SYM:
+    return x->var == y->var;
+  case AST_BI_OP:
+    return x->bi_op.op_type == y->bi_op.op_type &&
+      same_ast(x->bi_op.lhs, y->bi_op.lhs) &&
+      same_ast(x->bi_op.rhs, y->bi_op.rhs);
+  default:
+    return false;
+  }
+}
+
+// a op b as the machine computes it. false if that traps
+bool eval_bi_op(TokenType t, int a, int b, int* result) {
+  // unsigned arithmetic wraps around like add/sub/imul do
+  unsigned const x = a;
+  unsigned const y = b;
+  switch(t) {
+  case OP_PLUS_T:
+    *result = (int)(x + y);
+    return true;
+  case OP_MINUS_T:
+    *result = (int)(x - y);
+    return true;
+  case OP_MULTI_T:
+    *result = (int)(x * y);
+    return true;
+  case OP_DIV_T:
+    if(b == 0 || (a == INT_MIN && b == -1)) {
+      return false;
+    }
+    *result = a / b;
+    return true;
+  case OP_EQUAL_T:
+    *result = a == b;
+    return true;
+  default:
+    return false;
+  }
+}
+
+Ast* make_ast_neg(Ast* x) {
+  return make_ast_bi_op(OP_MINUS_T, make_ast_int(0), x);
+}
+
+Ast* fold_expr(Ast* ast);
+
+Ast* fold_bi_op(Ast* ast) {
+  TokenType const t = ast->bi_op.op_type;
+  Ast* lhs = fold_expr(ast->bi_op.lhs);
+  Ast* rhs = fold_expr(ast->bi_op.rhs);
+  ast->bi_op.lhs = lhs;
+  ast->bi_op.rhs = rhs;
+  if(t == OP_ASSIGN_T) {
+    return ast;
+  }
+  if(lhs->type == AST_INT && rhs->type == AST_INT) {
+    int n;
+    if(eval_bi_op(t, lhs->int_val, rhs->int_val, &n)) {
+      return make_ast_int(n);
+    }
+    return ast;
+  }
+  // constant to the right. evaluating it first changes nothing
+  if((t == OP_PLUS_T || t == OP_MULTI_T || t == OP_EQUAL_T) && lhs->type == AST_INT) {
+    ast->bi_op.lhs = rhs;
+    ast->bi_op.rhs = lhs;
+    lhs = ast->bi_op.lhs;
+    rhs = ast->bi_op.rhs;
+  }
+  if(rhs->type == AST_INT) {
+    int const n = rhs->int_val;
+    if((t == OP_PLUS_T || t == OP_MINUS_T) && n == 0) {
+      return lhs;
+    }
+    if((t == OP_MULTI_T || t == OP_DIV_T) && n == 1) {
+      return lhs;
+    }
+    // not x/-1, which traps for INT_MIN
+    if(t == OP_MULTI_T && n == -1) {
+      return make_ast_neg(lhs);
+    }
+    if(t == OP_MULTI_T && n == 0 && is_pure_ast(lhs)) {
+      return rhs;
+    }
+  }
+  if((t == OP_MINUS_T || t == OP_EQUAL_T) && is_pure_ast(lhs) && same_ast(lhs, rhs)) {
+    return make_ast_int(t == OP_MINUS_T ? 0 : 1);
+  }
+  return ast;
+}
+
+void fold_statement(Statement* s) {
+  switch(s->type) {
+  case NORMAL_STATEMENT:
+  case RETURN_STATEMENT:
+    s->val = fold_expr(s->val);
+    break;
+  case IF_STATEMENT:
+    s->if_val.cond = fold_expr(s->if_val.cond);
+    fold_statement(s->if_val.body);
+    if(s->if_val.else_body != NULL) {
+      fold_statement(s->if_val.else_body);
+    }
+    break;
+  case WHILE_STATEMENT:
+    s->while_val.cond = fold_expr(s->while_val.cond);
+    fold_statement(s->while_val.body);
+    break;
+  }
+}
+
+// returns the folded ast, which may be a new node
+Ast* fold_expr(Ast* ast) {
+  switch(ast->type) {
+  case AST_BI_OP:
+    return fold_bi_op(ast);
+  case AST_FUNCALL:
+    for(int i = 0; i < ast->funcall->argc; ++i) {
+      ast->funcall->args[i] = fold_expr(ast->funcall->args[i]);
+    }
+    return ast;
+  case AST_STATEMENT:
+    fold_statement(ast->statement);
+    return ast;
+  case AST_STATEMENTS:
+    FOREACH(Statement, ast->statements->val, s) {
+      fold_statement(s);
+    }
+    return ast;
+  case AST_BLOCK:
+    ast->block->val = fold_expr(ast->block->val);
+    return ast;
+  default:
+    return ast;
+  }
+}
+
+void fold_ast(Ast* ast) {
+  assert(ast->type == AST_GLOBAL);
+  FOREACH(Ast, ast->global->list, s) {
+    if(s->type == AST_FUNDEFIN) {
+      s->fundef->body = fold_expr(s->fundef->body);
+    }
+  }
+}
@@ -0,0 +1,14 @@
+#ifndef NNA774_KONOHA_FOLD_H
+#define NNA774_KONOHA_FOLD_H
+
+#include "ast.h"
+
+// folds constant integer expressions and simplifies x+0, x*1, x*-1, x-x, ...
+// in every function of an Ast(AST_GLOBAL). x*-1 becomes 0-x, which lower emits as neg.
+// division by zero and INT_MIN/-1 are left for the runtime
+void fold_ast(Ast*);
+// a t b with the wraparound of the generated code.
+// false for division by zero and INT_MIN/-1, which trap there
+bool eval_bi_op(TokenType t, int a, int b, int* result);
+
+#endif // NNA774_KONOHA_FOLD_H
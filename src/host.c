@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+
+// driver.c and self_driver.c. print_* return void there, 0 here
+int host_print_int(int n) { printf("%d", n); return 0; }
+int host_print_char(int c) { printf("%c", (char)c); return 0; }
+int host_succ(int n) { return n + 1; }
+int host_return42() { return 42; }
+int host_id(int n) { return n; }
+int host_add(int n, int m) { return n + m; }
+int host_add3(int n, int m, int o) { return n + m + o; }
+int host_add4(int n, int m, int o, int p) { return n + m + o + p; }
+int host_add5(int n, int m, int o, int p, int q) { return n + m + o + p + q; }
+int host_add6(int n, int m, int o, int p, int q, int r) { return n + m + o + p + q + r; }
+int host_mul(int n, int m) { return n * m; }
+
+HostFunction const HOST_FUNCTIONS[] = {
+  { "print_int", 1, (void*)host_print_int },
+  { "print_char", 1, (void*)host_print_char },
+  { "succ", 1, (void*)host_succ },
+  { "return42", 0, (void*)host_return42 },
+  { "id", 1, (void*)host_id },
+  { "add", 2, (void*)host_add },
+  { "add3", 3, (void*)host_add3 },
+  { "add4", 4, (void*)host_add4 },
+  { "add5", 5, (void*)host_add5 },
+  { "add6", 6, (void*)host_add6 },
+  { "mul", 2, (void*)host_mul },
+};
+int const NUMBER_OF_HOST_FUNCTIONS = sizeof(HOST_FUNCTIONS) / sizeof(*HOST_FUNCTIONS);
+
+HostFunction const* find_HostFunction(Symbol name) {
+  for(int i = 0; i < NUMBER_OF_HOST_FUNCTIONS; ++i) {
+    if(strcmp(HOST_FUNCTIONS[i].name, name) == 0) {
+      return &HOST_FUNCTIONS[i];
+    }
+  }
+  return NULL;
+}
+
+int call_HostFunction(HostFunction const* f, int const* args) {
+  switch(f->argc) {
+  case 0:
+    return ((int (*)(void))f->address)();
+  case 1:
+    return ((int (*)(int))f->address)(args[0]);
+  case 2:
+    return ((int (*)(int, int))f->address)(args[0], args[1]);
+  case 3:
+    return ((int (*)(int, int, int))f->address)(args[0], args[1], args[2]);
+  case 4:
+    return ((int (*)(int, int, int, int))f->address)(args[0], args[1], args[2], args[3]);
+  case 5:
+    return ((int (*)(int, int, int, int, int))f->address)(args[0], args[1], args[2], args[3], args[4]);
+  case 6:
+    return ((int (*)(int, int, int, int, int, int))f->address)(args[0], args[1], args[2], args[3], args[4], args[5]);
+  default:
+    warn("argc over 6 is not impled now");
+    return 0;
+  }
+}
@@ -0,0 +1,21 @@
+#ifndef NNA774_KONOHA_HOST_H
+#define NNA774_KONOHA_HOST_H
+
+#include "symbol.h"
+
+// functions built into konoha for programs run without linking:
+// print_int and print_char of driver.c and the helpers of self_driver.c
+struct HostFunction;
+typedef struct HostFunction HostFunction;
+
+struct HostFunction {
+  char const* name;
+  int argc;
+  void* address; // of a function taking argc ints
+};
+
+// NULL if there is no such function
+HostFunction const* find_HostFunction(Symbol name);
+int call_HostFunction(HostFunction const*, int const* args);
+
+#endif // NNA774_KONOHA_HOST_H
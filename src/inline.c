@@ -0,0 +1,145 @@
+#include "arena.h"
+#include "cfg.h"
+#include "inline.h"
+
+IrFunc const* find_IrFunc(IrProgram const* p, Symbol name) {
+  for(int i = 0; i < p->count; ++i) {
+    if(p->funcs[i].name == name) {
+      return &p->funcs[i];
+    }
+  }
+  return NULL;
+}
+
+bool calls_itself(IrFunc const* f) {
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      if(b->insts[j].op == IR_CALL && b->insts[j].name == f->name) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool can_inline(IrFunc const* f, IrInst const* call, IrFunc const* callee, int limit) {
+  return callee != NULL &&
+    callee != f &&
+    callee->argc == call->call.argc &&
+    IrFunc_inst_count(callee) <= limit &&
+    !calls_itself(callee);
+}
+
+// the callee's copy of src: its vregs are renumbered from base and its blocks from first
+void copy_inlined_inst(IrFunc* f, int block, IrFunc const* callee, IrInst const* src, Vreg base, int first) {
+  IrInst* const inst = append_IrInst(f, block, src->op);
+  *inst = *src;
+  if(inst->dst != NO_VREG) {
+    inst->dst += base;
+  }
+  assert(src->op != IR_PHI);
+  if(src->op == IR_CALL) {
+    Vreg* const args = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (src->call.argc + 1));
+    for(int k = 0; k < src->call.argc; ++k) {
+      args[k] = IrInst_use(callee, src, k) + base;
+    }
+    inst->call.args = append_call_args(f, args, src->call.argc);
+  } else {
+    for(int k = 0; k < IrInst_use_count(src); ++k) {
+      *IrInst_use_ref(f, inst, k) += base;
+    }
+  }
+  if(src->op == IR_JMP || src->op == IR_BR) {
+    inst->target[0] += first;
+  }
+  if(src->op == IR_BR) {
+    inst->target[1] += first;
+  }
+}
+
+// replaces the call at insts[index] of `block` with a copy of callee's blocks,
+// laid out right after it. returns the block with what followed the call
+int inline_call(IrFunc* f, int block, int index, IrFunc const* callee) {
+  IrInst const call = f->blocks[block].insts[index];
+  Vreg const base = f->vreg_count;
+  f->vreg_count += callee->vreg_count;
+  int const old_count = f->block_count;
+  int const first = f->block_count;
+  for(int i = 0; i < callee->block_count; ++i) {
+    new_IrBlock(f);
+  }
+  int const rest = new_IrBlock(f);
+
+  for(int j = index + 1; j < f->blocks[block].count; ++j) {
+    IrInst* const inst = append_IrInst(f, rest, IR_NOP);
+    *inst = f->blocks[block].insts[j];
+  }
+  f->blocks[block].count = index;
+
+  // parameters read the arguments, and returns jump to the rest
+  Vreg* const arg_vregs = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (call.call.argc + 1));
+  for(int k = 0; k < call.call.argc; ++k) {
+    arg_vregs[k] = IrInst_use(f, &call, k);
+  }
+  append_IrInst(f, block, IR_JMP)->target[0] = first;
+  for(int i = 0; i < callee->block_count; ++i) {
+    IrBlock const* const b = &callee->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      IrInst const* const src = &b->insts[j];
+      if(src->op == IR_PARAM) {
+        IrInst* const mov = append_IrInst(f, first + i, IR_MOV);
+        mov->dst = src->dst + base;
+        mov->a = arg_vregs[src->imm];
+      } else if(src->op == IR_RET) {
+        if(src->a != NO_VREG && call.dst != NO_VREG) {
+          IrInst* const mov = append_IrInst(f, first + i, IR_MOV);
+          mov->dst = call.dst;
+          mov->a = src->a + base;
+        }
+        append_IrInst(f, first + i, IR_JMP)->target[0] = rest;
+      } else {
+        copy_inlined_inst(f, first + i, callee, src, base, first);
+      }
+    }
+  }
+
+  int* const order = region_alloc(CODEGEN_REGION, sizeof(int) * f->block_count);
+  int n = 0;
+  for(int i = 0; i <= block; ++i) {
+    order[n++] = i;
+  }
+  for(int i = first; i <= rest; ++i) {
+    order[n++] = i;
+  }
+  for(int i = block + 1; i < old_count; ++i) {
+    order[n++] = i;
+  }
+  reorder_IrBlocks(f, order, n);
+  return block + 1 + callee->block_count;
+}
+
+void inline_calls(IrProgram* p, int limit) {
+  for(int k = 0; k < p->count; ++k) {
+    IrFunc* const f = &p->funcs[k];
+    bool inlined = false;
+    // scanning resumes after each inlined body, so copies are never inlined into again
+    for(int i = 0; i < f->block_count; ++i) {
+      for(int j = 0; j < f->blocks[i].count; ++j) {
+        IrInst const* const inst = &f->blocks[i].insts[j];
+        if(inst->op != IR_CALL) {
+          continue;
+        }
+        IrFunc const* const callee = find_IrFunc(p, inst->name);
+        if(can_inline(f, inst, callee, limit)) {
+          i = inline_call(f, i, j, callee);
+          j = -1;
+          inlined = true;
+        }
+      }
+    }
+    if(inlined) {
+      merge_blocks(f);
+    }
+  }
+}
@@ -0,0 +1,10 @@
+#ifndef NNA774_KONOHA_INLINE_H
+#define NNA774_KONOHA_INLINE_H
+
+#include "ir.h"
+
+// copies callees of at most `limit` instructions into their call sites.
+// functions calling themselves are never inlined. works on IR out of SSA
+void inline_calls(IrProgram*, int limit);
+
+#endif // NNA774_KONOHA_INLINE_H
@@ -0,0 +1,460 @@
+#include <stdint.h>
+#include "arena.h"
+#include "fold.h"
+#include "host.h"
+#include "interp.h"
+
+// either a function of the program or a host one
+struct Function;
+typedef struct Function Function;
+
+struct Function {
+  Symbol name;
+  FunDef const* def; // NULL for host ones
+  HostFunction const* host;
+  int argc;
+  int frame_size; // args first, then every defined Var
+};
+
+// in ints. bounds the depth of calls along with INTERP_TASK_COUNT
+int const INTERP_STACK_SIZE = 1 << 22;
+int const INTERP_TASK_COUNT = 1 << 22;
+
+// what is left to do, innermost last. nothing recurses in C, so deep
+// recursion of the program only takes stack and tasks
+typedef enum {
+  EVAL_TASK, // pushes the value of ast(which isn't a leaf, see push_eval)
+  EXEC_TASK, // runs ast for its effect
+  STATEMENT_TASK,
+  SEQUENCE_TASK, // runs statement and the ones after it
+  DROP_TASK, // pops a value
+  CALL_TASK, // returns to caller_fp. step is 1 once the return value is pushed
+} TaskType;
+
+struct Task;
+typedef struct Task Task;
+
+struct Task {
+  TaskType type;
+  int step; // how far the task has gone, e.g. how many args are evaluated
+  union {
+    Ast const* ast;
+    Statement const* statement;
+    int caller_fp;
+  };
+};
+
+struct Interp;
+typedef struct Interp Interp;
+
+struct Interp {
+  Function* funcs;
+  int func_count;
+  int func_capacity;
+  SymbolMap* func_indices; // index + 1
+  // frames, each followed by the values computed in it so far
+  int* stack;
+  int sp; // the first free slot
+  int fp; // the current frame
+  Task* tasks;
+  int task_count;
+  int ret; // of main
+  bool trapped;
+};
+
+int add_Function(Interp* I, Symbol name, FunDef const* def, HostFunction const* host) {
+  GROW_ARRAY(Function, I->funcs, I->func_count, I->func_capacity, 16);
+  Function* const f = &I->funcs[I->func_count];
+  f->name = name;
+  f->def = def;
+  f->host = host;
+  f->argc = def != NULL ? def->type.argc : host->argc;
+  f->frame_size = f->argc;
+  SymbolMap_insert(I->func_indices, name, (void*)(intptr_t)(I->func_count + 1));
+  return I->func_count++;
+}
+
+// -1 if there is no such function
+int find_Function(Interp* I, Symbol name) {
+  intptr_t const found = (intptr_t)SymbolMap_find(I->func_indices, name);
+  if(found != 0) {
+    return found - 1;
+  }
+  HostFunction const* const host = find_HostFunction(name);
+  return host != NULL ? add_Function(I, name, NULL, host) : -1;
+}
+
+bool resolve_statement(Interp* I, int func, Statement const* s);
+
+// gives each defined Var a slot and each call its callee, so running does no
+// name lookups. funcs may move, so the function is passed by index
+bool resolve(Interp* I, int func, Ast* ast) {
+  switch(ast->type) {
+  case AST_BI_OP:
+    return resolve(I, func, ast->bi_op.lhs) && resolve(I, func, ast->bi_op.rhs);
+  case AST_SYM_DEFINE:
+    ast->var->id = I->funcs[func].frame_size++;
+    return true;
+  case AST_FUNCALL: {
+    FunCall* const call = ast->funcall;
+    call->id = find_Function(I, call->name);
+    if(call->id < 0) {
+      warn("undefined function: %s\n", call->name);
+      return false;
+    }
+    if(call->argc != I->funcs[call->id].argc) {
+      warn("%s takes %d args, but given %d\n", call->name, I->funcs[call->id].argc, call->argc);
+      return false;
+    }
+    for(int i = 0; i < call->argc; ++i) {
+      if(!resolve(I, func, call->args[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+  case AST_STATEMENT:
+    return resolve_statement(I, func, ast->statement);
+  case AST_STATEMENTS:
+    FOREACH(Statement, ast->statements->val, s) {
+      if(!resolve_statement(I, func, s)) {
+        return false;
+      }
+    }
+    return true;
+  case AST_BLOCK:
+    return resolve(I, func, ast->block->val);
+  default:
+    return true;
+  }
+}
+
+bool resolve_statement(Interp* I, int func, Statement const* s) {
+  switch(s->type) {
+  case NORMAL_STATEMENT:
+  case RETURN_STATEMENT:
+    return resolve(I, func, s->val);
+  case IF_STATEMENT:
+    return resolve(I, func, s->if_val.cond) && resolve_statement(I, func, s->if_val.body)
+      && (s->if_val.else_body == NULL || resolve_statement(I, func, s->if_val.else_body));
+  case WHILE_STATEMENT:
+    return resolve(I, func, s->while_val.cond) && resolve_statement(I, func, s->while_val.body);
+  default:
+    warn("unimpled statement type(%s)\n", show_StatementType(s->type));
+    return false;
+  }
+}
+
+int trap(Interp* I, char const* reason) {
+  if(!I->trapped) {
+    warn("%s\n", reason);
+  }
+  I->trapped = true;
+  return 0;
+}
+
+void push_value(Interp* I, int v) {
+  if(I->sp == INTERP_STACK_SIZE) {
+    trap(I, "stack overflow");
+    return;
+  }
+  I->stack[I->sp++] = v;
+}
+
+int pop_value(Interp* I) {
+  return I->stack[--I->sp];
+}
+
+// NULL after a trap
+Task* push_task(Interp* I, TaskType type) {
+  if(I->task_count == INTERP_TASK_COUNT) {
+    trap(I, "stack overflow");
+    return NULL;
+  }
+  Task* const t = &I->tasks[I->task_count++];
+  t->type = type;
+  t->step = 0;
+  return t;
+}
+
+void push_ast_task(Interp* I, TaskType type, Ast const* ast) {
+  Task* const t = push_task(I, type);
+  if(t != NULL) {
+    t->ast = ast;
+  }
+}
+
+void push_statement_task(Interp* I, TaskType type, Statement const* s) {
+  Task* const t = push_task(I, type);
+  if(t != NULL) {
+    t->statement = s;
+  }
+}
+
+// leaves take no task
+void push_eval(Interp* I, Ast const* ast) {
+  if(ast->type == AST_INT) {
+    push_value(I, ast->int_val);
+  } else if(ast->type == AST_SYM) {
+    push_value(I, I->stack[I->fp + ast->var->id]);
+  } else {
+    push_ast_task(I, EVAL_TASK, ast);
+  }
+}
+
+// zeroes the Vars of f's frame, whose args are at stack[base] on
+bool enter_frame(Interp* I, Function const* f, int base) {
+  if(base + f->frame_size > INTERP_STACK_SIZE) {
+    trap(I, "stack overflow");
+    return false;
+  }
+  for(int i = base + f->argc; i < base + f->frame_size; ++i) {
+    I->stack[i] = 0;
+  }
+  I->sp = base + f->frame_size;
+  return true;
+}
+
+// the args are the argc values on top, which become the frame
+void call_Function(Interp* I, int func, int argc) {
+  Function const* const f = &I->funcs[func];
+  int const base = I->sp - argc;
+  if(f->host != NULL) {
+    int const result = call_HostFunction(f->host, &I->stack[base]);
+    I->sp = base;
+    push_value(I, result);
+    return;
+  }
+  Task* const call = push_task(I, CALL_TASK);
+  if(call == NULL || !enter_frame(I, f, base)) {
+    return;
+  }
+  call->caller_fp = I->fp;
+  I->fp = base;
+  push_ast_task(I, EXEC_TASK, f->def->body);
+}
+
+// drops the tasks of the current call up to its CALL_TASK
+void unwind(Interp* I) {
+  while(I->tasks[I->task_count - 1].type != CALL_TASK) {
+    --I->task_count;
+  }
+}
+
+// the callee takes over the frame, so tail recursion runs in constant space
+void tail_call_Function(Interp* I, int func, int argc) {
+  Function const* const f = &I->funcs[func];
+  memmove(&I->stack[I->fp], &I->stack[I->sp - argc], sizeof(int) * argc);
+  if(!enter_frame(I, f, I->fp)) {
+    return;
+  }
+  unwind(I);
+  push_ast_task(I, EXEC_TASK, f->def->body);
+}
+
+void step_eval(Interp* I, Task* t) {
+  Ast const* const ast = t->ast;
+  switch(ast->type) {
+  case AST_BI_OP: {
+    TokenType const op = ast->bi_op.op_type;
+    if(op == OP_ASSIGN_T) {
+      if(t->step++ == 0) {
+        push_eval(I, ast->bi_op.rhs);
+        return;
+      }
+      --I->task_count;
+      I->stack[I->fp + ast->bi_op.lhs->var->id] = I->stack[I->sp - 1];
+      return;
+    }
+    if(t->step < 2) {
+      push_eval(I, t->step++ == 0 ? ast->bi_op.lhs : ast->bi_op.rhs);
+      return;
+    }
+    --I->task_count;
+    int const b = pop_value(I);
+    int const a = pop_value(I);
+    int result;
+    if(!eval_bi_op(op, a, b, &result)) {
+      trap(I, op == OP_DIV_T ? "division overflow" : "unknown operator");
+      return;
+    }
+    push_value(I, result);
+    return;
+  }
+  case AST_FUNCALL: {
+    FunCall const* const call = ast->funcall;
+    if(t->step < call->argc) {
+      push_eval(I, call->args[t->step++]);
+      return;
+    }
+    --I->task_count;
+    call_Function(I, call->id, call->argc);
+    return;
+  }
+  default:
+    trap(I, "not an expression");
+    return;
+  }
+}
+
+void step_statement(Interp* I, Task* t) {
+  Statement const* const s = t->statement;
+  switch(s->type) {
+  case NORMAL_STATEMENT:
+    t->type = EXEC_TASK;
+    t->ast = s->val;
+    return;
+  case RETURN_STATEMENT: {
+    Ast const* const val = s->val;
+    if(val->type == AST_FUNCALL && I->funcs[val->funcall->id].def != NULL) {
+      if(t->step < val->funcall->argc) {
+        push_eval(I, val->funcall->args[t->step++]);
+        return;
+      }
+      tail_call_Function(I, val->funcall->id, val->funcall->argc);
+      return;
+    }
+    if(t->step++ == 0) {
+      push_eval(I, val);
+      return;
+    }
+    unwind(I);
+    I->tasks[I->task_count - 1].step = 1;
+    return;
+  }
+  case IF_STATEMENT:
+    if(t->step++ == 0) {
+      push_eval(I, s->if_val.cond);
+      return;
+    }
+    --I->task_count;
+    if(pop_value(I) != 0) {
+      push_statement_task(I, STATEMENT_TASK, s->if_val.body);
+    } else if(s->if_val.else_body != NULL) {
+      push_statement_task(I, STATEMENT_TASK, s->if_val.else_body);
+    }
+    return;
+  case WHILE_STATEMENT:
+    if(t->step == 0) {
+      t->step = 1;
+      push_eval(I, s->while_val.cond);
+      return;
+    }
+    if(pop_value(I) == 0) {
+      --I->task_count;
+      return;
+    }
+    t->step = 0;
+    push_statement_task(I, STATEMENT_TASK, s->while_val.body);
+    return;
+  default:
+    --I->task_count;
+    return;
+  }
+}
+
+void step_exec(Interp* I, Task* t) {
+  Ast const* const ast = t->ast;
+  switch(ast->type) {
+  case AST_SYM_DEFINE:
+  case AST_EMPTY:
+    --I->task_count;
+    return;
+  case AST_STATEMENT:
+    t->type = STATEMENT_TASK;
+    t->statement = ast->statement;
+    return;
+  case AST_STATEMENTS:
+    t->type = SEQUENCE_TASK;
+    t->statement = ast->statements->val->head;
+    return;
+  case AST_BLOCK:
+    t->ast = ast->block->val;
+    return;
+  default:
+    // an expression statement
+    t->type = DROP_TASK;
+    push_eval(I, ast);
+    return;
+  }
+}
+
+void step_return(Interp* I, Task* t) {
+  int const result = t->step != 0 ? I->stack[I->sp - 1] : 0; // 0 when falling off the end
+  --I->task_count;
+  I->sp = I->fp;
+  I->fp = t->caller_fp;
+  if(I->task_count == 0) {
+    I->ret = result;
+    return;
+  }
+  push_value(I, result);
+}
+
+void step(Interp* I) {
+  Task* const t = &I->tasks[I->task_count - 1];
+  switch(t->type) {
+  case EVAL_TASK:
+    step_eval(I, t);
+    break;
+  case EXEC_TASK:
+    step_exec(I, t);
+    break;
+  case STATEMENT_TASK:
+    step_statement(I, t);
+    break;
+  case SEQUENCE_TASK: {
+    Statement const* const s = t->statement;
+    if(s == NULL) {
+      --I->task_count;
+      break;
+    }
+    t->statement = s->_hook.next;
+    push_statement_task(I, STATEMENT_TASK, s);
+    break;
+  }
+  case DROP_TASK:
+    --I->task_count;
+    --I->sp;
+    break;
+  case CALL_TASK:
+    step_return(I, t);
+    break;
+  }
+}
+
+int interpret(Ast* ast) {
+  assert(ast != NULL);
+  assert(ast->type == AST_GLOBAL);
+  Interp interp = { NULL, 0, 0, new_SymbolMap(), NULL, 0, -1, NULL, 0, 0, false };
+  Interp* const I = &interp;
+  FOREACH(Ast, ast->global->list, s) {
+    assert(s->type == AST_FUNDEFIN);
+    if(SymbolMap_find(I->func_indices, s->fundef->name) != NULL) {
+      warn("%s is defined twice\n", s->fundef->name);
+      return 1;
+    }
+    FunDef const* const def = s->fundef;
+    add_Function(I, def->name, def, NULL);
+    for(int i = 0; i < def->type.argc; ++i) {
+      def->args[i]->id = i;
+    }
+  }
+  for(int i = 0; i < I->func_count; ++i) {
+    if(I->funcs[i].def != NULL && !resolve(I, i, I->funcs[i].def->body)) {
+      return 1;
+    }
+  }
+  int const main = find_Function(I, intern_cstr("main"));
+  if(main < 0 || I->funcs[main].def == NULL) {
+    warn("no main\n");
+    return 1;
+  }
+  I->stack = region_alloc(CODEGEN_REGION, sizeof(int) * INTERP_STACK_SIZE);
+  I->tasks = region_alloc(CODEGEN_REGION, sizeof(Task) * INTERP_TASK_COUNT);
+  call_Function(I, main, 0);
+  while(I->task_count > 0 && !I->trapped) {
+    step(I);
+  }
+  return I->trapped ? 1 : I->ret;
+}
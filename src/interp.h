@@ -0,0 +1,14 @@
+#ifndef NNA774_KONOHA_INTERP_H
+#define NNA774_KONOHA_INTERP_H
+
+#include "ast.h"
+
+// runs main of an Ast(AST_GLOBAL) by walking it, without any codegen, and
+// returns what main returns. the Ast should be unfolded to serve as an oracle
+// for the passes. calls to undefined functions go to the host ones(see host.h).
+// calls don't recurse in C, so their depth is bounded only by the interpreter's
+// own stack(see INTERP_STACK_SIZE). reassigns Var.id(a frame slot here) and
+// FunCall.id, so lower after this gives each Var its vreg again
+int interpret(Ast* ast);
+
+#endif // NNA774_KONOHA_INTERP_H
@@ -0,0 +1,341 @@
+#include <string.h>
+#include "arena.h"
+#include "ir.h"
+
+IrProgram* new_IrProgram() {
+  IrProgram* const p = region_alloc(CODEGEN_REGION, sizeof(IrProgram));
+  p->funcs = NULL;
+  p->count = 0;
+  p->capacity = 0;
+  return p;
+}
+
+IrFunc* add_IrFunc(IrProgram* p, Symbol name, int argc) {
+  GROW_ARRAY(IrFunc, p->funcs, p->count, p->capacity, 8);
+  IrFunc* const f = &p->funcs[p->count++];
+  f->name = name;
+  f->argc = argc;
+  f->blocks = NULL;
+  f->block_count = 0;
+  f->block_capacity = 0;
+  f->vreg_count = 0;
+  f->call_args = NULL;
+  f->call_arg_count = 0;
+  f->call_arg_capacity = 0;
+  f->phi_args = NULL;
+  f->phi_arg_count = 0;
+  f->phi_arg_capacity = 0;
+  return f;
+}
+
+int new_IrBlock(IrFunc* f) {
+  GROW_ARRAY(IrBlock, f->blocks, f->block_count, f->block_capacity, 8);
+  IrBlock* const b = &f->blocks[f->block_count];
+  b->insts = NULL;
+  b->count = 0;
+  b->capacity = 0;
+  return f->block_count++;
+}
+
+Vreg new_Vreg(IrFunc* f) {
+  return f->vreg_count++;
+}
+
+IrInst* append_IrInst(IrFunc* f, int block, IrOp op) {
+  assert(0 <= block && block < f->block_count);
+  return insert_IrInst(f, block, f->blocks[block].count, op);
+}
+
+IrInst* insert_IrInst(IrFunc* f, int block, int index, IrOp op) {
+  assert(0 <= block && block < f->block_count);
+  IrBlock* const b = &f->blocks[block];
+  assert(0 <= index && index <= b->count);
+  GROW_ARRAY(IrInst, b->insts, b->count, b->capacity, 8);
+  memmove(&b->insts[index + 1], &b->insts[index], sizeof(IrInst) * (b->count - index));
+  ++b->count;
+  IrInst* const inst = &b->insts[index];
+  inst->op = op;
+  inst->dst = NO_VREG;
+  inst->a = NO_VREG;
+  inst->b = NO_VREG;
+  inst->target[0] = -1;
+  inst->target[1] = -1;
+  inst->name = NULL;
+  return inst;
+}
+
+int append_call_args(IrFunc* f, Vreg const* args, int argc) {
+  int const first = f->call_arg_count;
+  for(int i = 0; i < argc; ++i) {
+    GROW_ARRAY(Vreg, f->call_args, f->call_arg_count, f->call_arg_capacity, 16);
+    f->call_args[f->call_arg_count++] = args[i];
+  }
+  return first;
+}
+
+int append_phi_args(IrFunc* f, IrPhiArg const* args, int argc) {
+  int const first = f->phi_arg_count;
+  for(int i = 0; i < argc; ++i) {
+    GROW_ARRAY(IrPhiArg, f->phi_args, f->phi_arg_count, f->phi_arg_capacity, 16);
+    f->phi_args[f->phi_arg_count++] = args[i];
+  }
+  return first;
+}
+
+IrInst* IrBlock_terminator(IrBlock const* b) {
+  assert(b->count != 0);
+  IrInst* const last = &b->insts[b->count - 1];
+  assert(IrOp_is_terminator(last->op));
+  return last;
+}
+
+int IrBlock_successors(IrBlock const* b, int succ[2]) {
+  IrInst const* const t = IrBlock_terminator(b);
+  switch(t->op) {
+  case IR_JMP:
+    succ[0] = t->target[0];
+    return 1;
+  case IR_BR:
+    succ[0] = t->target[0];
+    succ[1] = t->target[1];
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+void reorder_IrBlocks(IrFunc* f, int const* order, int n) {
+  assert(n > 0);
+  int* const renumber = region_alloc(CODEGEN_REGION, sizeof(int) * f->block_count);
+  for(int i = 0; i < f->block_count; ++i) {
+    renumber[i] = -1;
+  }
+  IrBlock* const blocks = region_alloc(CODEGEN_REGION, sizeof(IrBlock) * n);
+  for(int i = 0; i < n; ++i) {
+    renumber[order[i]] = i;
+    blocks[i] = f->blocks[order[i]];
+  }
+  for(int i = 0; i < n; ++i) {
+    IrInst* const t = IrBlock_terminator(&blocks[i]);
+    int const targets = t->op == IR_BR ? 2 : t->op == IR_JMP ? 1 : 0;
+    for(int j = 0; j < targets; ++j) {
+      assert(renumber[t->target[j]] >= 0);
+      t->target[j] = renumber[t->target[j]];
+    }
+    for(int j = 0; j < blocks[i].count && blocks[i].insts[j].op == IR_PHI; ++j) {
+      IrInst* const phi = &blocks[i].insts[j];
+      // args from dropped blocks are for edges which don't exist anymore
+      IrPhiArg* const args = &f->phi_args[phi->phi.args];
+      int argc = 0;
+      for(int k = 0; k < phi->phi.argc; ++k) {
+        if(renumber[args[k].block] >= 0) {
+          args[argc].block = renumber[args[k].block];
+          args[argc].vreg = args[k].vreg;
+          ++argc;
+        }
+      }
+      phi->phi.argc = argc;
+    }
+  }
+  f->blocks = blocks;
+  f->block_count = n;
+  f->block_capacity = n;
+}
+
+bool IrOp_is_binary(IrOp op) {
+  switch(op) {
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_EQ:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool IrOp_is_terminator(IrOp op) {
+  return op == IR_JMP || op == IR_BR || op == IR_RET;
+}
+
+int IrInst_use_count(IrInst const* inst) {
+  switch(inst->op) {
+  case IR_CONST:
+  case IR_PARAM:
+  case IR_JMP:
+  case IR_NOP:
+    return 0;
+  case IR_MOV:
+  case IR_NEG:
+  case IR_SHL:
+  case IR_SAR:
+  case IR_SHR:
+  case IR_BR:
+    return 1;
+  case IR_RET:
+    return inst->a == NO_VREG ? 0 : 1;
+  case IR_CALL:
+    return inst->call.argc;
+  case IR_PHI:
+    return inst->phi.argc;
+  default:
+    assert(IrOp_is_binary(inst->op));
+    return 2;
+  }
+}
+
+Vreg* IrInst_use_ref(IrFunc const* f, IrInst const* inst, int i) {
+  assert(0 <= i && i < IrInst_use_count(inst));
+  if(inst->op == IR_CALL) {
+    return &f->call_args[inst->call.args + i];
+  }
+  if(inst->op == IR_PHI) {
+    return &f->phi_args[inst->phi.args + i].vreg;
+  }
+  return (Vreg*)(i == 0 ? &inst->a : &inst->b);
+}
+
+Vreg IrInst_use(IrFunc const* f, IrInst const* inst, int i) {
+  return *IrInst_use_ref(f, inst, i);
+}
+
+int IrFunc_inst_count(IrFunc const* f) {
+  int n = 0;
+  for(int i = 0; i < f->block_count; ++i) {
+    n += f->blocks[i].count;
+  }
+  return n;
+}
+
+void compact_IrBlock(IrBlock* b) {
+  int n = 0;
+  for(int i = 0; i < b->count; ++i) {
+    if(b->insts[i].op != IR_NOP) {
+      b->insts[n++] = b->insts[i];
+    }
+  }
+  b->count = n;
+}
+
+char const* IrOp_mnemonic(IrOp op) {
+  switch(op) {
+  case IR_CONST:
+    return "const";
+  case IR_PARAM:
+    return "param";
+  case IR_MOV:
+    return "mov";
+  case IR_ADD:
+    return "add";
+  case IR_SUB:
+    return "sub";
+  case IR_MUL:
+    return "mul";
+  case IR_DIV:
+    return "div";
+  case IR_EQ:
+    return "eq";
+  case IR_NEG:
+    return "neg";
+  case IR_SHL:
+    return "shl";
+  case IR_SAR:
+    return "sar";
+  case IR_SHR:
+    return "shr";
+  case IR_CALL:
+    return "call";
+  case IR_JMP:
+    return "jmp";
+  case IR_BR:
+    return "br";
+  case IR_RET:
+    return "ret";
+  case IR_PHI:
+    return "phi";
+  case IR_NOP:
+    return "nop";
+  }
+  return "?";
+}
+
+void write_Vreg(Writer* w, Vreg v) {
+  write_char(w, '%');
+  write_int(w, v);
+}
+
+void write_IrInst(Writer* w, IrFunc const* f, IrInst const* inst) {
+  if(inst->dst != NO_VREG) {
+    write_Vreg(w, inst->dst);
+    write_str(w, " = ");
+  }
+  write_str(w, IrOp_mnemonic(inst->op));
+  switch(inst->op) {
+  case IR_CONST:
+  case IR_PARAM:
+    write_char(w, ' ');
+    write_int(w, inst->imm);
+    break;
+  case IR_CALL:
+    writef(w, " %s(", inst->name);
+    for(int i = 0; i < inst->call.argc; ++i) {
+      if(i != 0) {
+        write_str(w, ", ");
+      }
+      write_Vreg(w, IrInst_use(f, inst, i));
+    }
+    write_char(w, ')');
+    break;
+  case IR_SHL:
+  case IR_SAR:
+  case IR_SHR:
+    write_char(w, ' ');
+    write_Vreg(w, inst->a);
+    writef(w, ", %d", inst->imm);
+    break;
+  case IR_JMP:
+    writef(w, " b%d", inst->target[0]);
+    break;
+  case IR_BR:
+    write_char(w, ' ');
+    write_Vreg(w, inst->a);
+    writef(w, ", b%d, b%d", inst->target[0], inst->target[1]);
+    break;
+  case IR_PHI:
+    for(int i = 0; i < inst->phi.argc; ++i) {
+      IrPhiArg const* const arg = &f->phi_args[inst->phi.args + i];
+      writef(w, i == 0 ? " [b%d: " : ", [b%d: ", arg->block);
+      write_Vreg(w, arg->vreg);
+      write_char(w, ']');
+    }
+    break;
+  default:
+    for(int i = 0; i < IrInst_use_count(inst); ++i) {
+      write_str(w, i == 0 ? " " : ", ");
+      write_Vreg(w, IrInst_use(f, inst, i));
+    }
+    break;
+  }
+}
+
+void write_IrFunc(Writer* w, IrFunc const* f) {
+  writef(w, "%s(%d):\n", f->name, f->argc);
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    writef(w, "b%d:\n", i);
+    for(int j = 0; j < b->count; ++j) {
+      write_char(w, '\t');
+      write_IrInst(w, f, &b->insts[j]);
+      write_char(w, '\n');
+    }
+  }
+}
+
+void print_IrProgram(IrProgram const* p) {
+  Writer* const w = new_Writer(stdout);
+  for(int i = 0; i < p->count; ++i) {
+    write_IrFunc(w, &p->funcs[i]);
+  }
+  flush_Writer(w);
+}
@@ -0,0 +1,131 @@
+#ifndef NNA774_KONOHA_IR_H
+#define NNA774_KONOHA_IR_H
+
+#include "enum.h"
+#include "symbol.h"
+#include "writer.h"
+
+// three-address IR. everything is stored in arrays and refers to
+// other parts by index(vreg, block or call argument number), never by pointer.
+
+// virtual register. a function has vreg_count of them, numbered from 0
+typedef int Vreg;
+#define NO_VREG (-1)
+
+ENUM_WITH_SHOW(
+  IrOp,
+  IR_CONST, // dst = imm
+  IR_PARAM, // dst = imm-th parameter
+  IR_MOV,   // dst = a
+  IR_ADD,   // dst = a + b
+  IR_SUB,   // dst = a - b
+  IR_MUL,   // dst = a * b
+  IR_DIV,   // dst = a / b
+  IR_EQ,    // dst = a == b
+  IR_NEG,   // dst = -a
+  IR_SHL,   // dst = a << imm
+  IR_SAR,   // dst = a >> imm(arithmetic)
+  IR_SHR,   // dst = a >> imm(logical)
+  IR_CALL,  // dst = name(call_args[args], ..., call_args[args + argc - 1])
+  IR_JMP,   // goto target[0]
+  IR_BR,    // if a goto target[0] else target[1]
+  IR_RET,   // return a(a may be NO_VREG)
+  IR_PHI,   // dst = the one of phi_args[args ...] whose block we came from(SSA only)
+  IR_NOP,   // removed by compact_IrBlock
+)
+
+struct IrInst;
+typedef struct IrInst IrInst;
+struct IrBlock;
+typedef struct IrBlock IrBlock;
+struct IrFunc;
+typedef struct IrFunc IrFunc;
+struct IrProgram;
+typedef struct IrProgram IrProgram;
+struct IrPhiArg;
+typedef struct IrPhiArg IrPhiArg;
+
+struct IrInst {
+  IrOp op;
+  Vreg dst;
+  Vreg a;
+  Vreg b;
+  union {
+    int imm;
+    int target[2];
+    struct {
+      int args;
+      int argc;
+    } call;
+    struct {
+      int args;
+      int argc;
+    } phi;
+  };
+  Symbol name; // IR_CALL
+};
+
+struct IrPhiArg {
+  int block; // predecessor
+  Vreg vreg;
+};
+
+// instructions of a block. phis come first, and the last one is always IR_JMP, IR_BR or IR_RET
+struct IrBlock {
+  IrInst* insts;
+  int count;
+  int capacity;
+};
+
+struct IrFunc {
+  Symbol name;
+  int argc;
+  IrBlock* blocks; // blocks[0] is the entry. the array order is the code layout
+  int block_count;
+  int block_capacity;
+  int vreg_count;
+  Vreg* call_args;
+  int call_arg_count;
+  int call_arg_capacity;
+  IrPhiArg* phi_args;
+  int phi_arg_count;
+  int phi_arg_capacity;
+};
+
+struct IrProgram {
+  IrFunc* funcs;
+  int count;
+  int capacity;
+};
+
+IrProgram* new_IrProgram();
+IrFunc* add_IrFunc(IrProgram*, Symbol name, int argc);
+int new_IrBlock(IrFunc*);
+Vreg new_Vreg(IrFunc*);
+IrInst* append_IrInst(IrFunc*, int block, IrOp);
+// inserts before insts[index]
+IrInst* insert_IrInst(IrFunc*, int block, int index, IrOp);
+int append_call_args(IrFunc*, Vreg const* args, int argc);
+int append_phi_args(IrFunc*, IrPhiArg const* args, int argc);
+
+IrInst* IrBlock_terminator(IrBlock const*);
+// writes successor blocks to `succ` and returns how many there are
+int IrBlock_successors(IrBlock const*, int succ[2]);
+// keeps only blocks order[0..n) in that order and renumbers jump targets.
+// order[0] becomes the entry
+void reorder_IrBlocks(IrFunc*, int const* order, int n);
+
+bool IrOp_is_binary(IrOp);
+bool IrOp_is_terminator(IrOp);
+// vregs read by an instruction
+int IrInst_use_count(IrInst const*);
+Vreg* IrInst_use_ref(IrFunc const*, IrInst const*, int i);
+Vreg IrInst_use(IrFunc const*, IrInst const*, int i);
+int IrFunc_inst_count(IrFunc const*);
+void compact_IrBlock(IrBlock*);
+
+void write_IrInst(Writer*, IrFunc const*, IrInst const*);
+void write_IrFunc(Writer*, IrFunc const*);
+void print_IrProgram(IrProgram const*);
+
+#endif // NNA774_KONOHA_IR_H
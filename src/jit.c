@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <sys/mman.h>
+#include "arena.h"
+#include "host.h"
+#include "jit.h"
+
+// host functions may be too far for a rel32, so calls go through a stub
+// after the code: `jmp *0(%rip)` followed by the address
+int const STUB_SIZE = 16;
+
+void write_stub(uint8_t* p, void* target) {
+  uintptr_t const address = (uintptr_t)target;
+  p[0] = 0xff;
+  p[1] = 0x25;
+  memset(p + 2, 0, 4);
+  memcpy(p + 6, &address, sizeof(address));
+}
+
+int run_jit(ObjectFile const* obj) {
+  // resolve everything first: a host function called with the wrong number of
+  // args would read garbage registers
+  HostFunction const** const hosts = region_alloc(CODEGEN_REGION, sizeof(HostFunction const*) * (obj->symbol_count + 1));
+  int entry_symbol = -1;
+  for(int i = 0; i < obj->symbol_count; ++i) {
+    ObjectSymbol const* const s = &obj->symbols[i];
+    hosts[i] = NULL;
+    if(s->defined) {
+      if(strcmp(s->name, "main") == 0) {
+        entry_symbol = i;
+      }
+      continue;
+    }
+    hosts[i] = find_HostFunction(s->name);
+    if(hosts[i] == NULL) {
+      warn("undefined function: %s\n", s->name);
+      return 1;
+    }
+  }
+  if(entry_symbol < 0) {
+    warn("no main\n");
+    return 1;
+  }
+  for(int i = 0; i < obj->relocation_count; ++i) {
+    Relocation const* const r = &obj->relocations[i];
+    HostFunction const* const host = hosts[r->symbol];
+    if(host != NULL && host->argc != r->argc) {
+      warn("%s takes %d args, but given %d\n", host->name, host->argc, r->argc);
+      return 1;
+    }
+  }
+
+  size_t const stubs_offset = (obj->text->length + 15) / 16 * 16;
+  size_t const size = stubs_offset + STUB_SIZE * obj->symbol_count;
+  uint8_t* const code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(code == MAP_FAILED) {
+    warn("can't map memory for the code\n");
+    return 1;
+  }
+  memcpy(code, obj->text->buf, obj->text->length);
+
+  uint8_t** const addresses = region_alloc(CODEGEN_REGION, sizeof(uint8_t*) * (obj->symbol_count + 1));
+  for(int i = 0; i < obj->symbol_count; ++i) {
+    ObjectSymbol const* const s = &obj->symbols[i];
+    if(s->defined) {
+      addresses[i] = code + s->offset;
+      continue;
+    }
+    addresses[i] = code + stubs_offset + STUB_SIZE * i;
+    write_stub(addresses[i], hosts[i]->address);
+  }
+  uint8_t* const entry = addresses[entry_symbol];
+  for(int i = 0; i < obj->relocation_count; ++i) {
+    Relocation const* const r = &obj->relocations[i];
+    int32_t const rel = addresses[r->symbol] - (code + r->offset + 4);
+    memcpy(code + r->offset, &rel, sizeof(rel));
+  }
+
+  if(mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+    warn("can't make the code executable\n");
+    munmap(code, size);
+    return 1;
+  }
+  int const result = ((int (*)(void))entry)();
+  munmap(code, size);
+  return result;
+}
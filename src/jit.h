@@ -0,0 +1,11 @@
+#ifndef NNA774_KONOHA_JIT_H
+#define NNA774_KONOHA_JIT_H
+
+#include "object.h"
+
+// loads the code of obj into executable memory, calls its main and returns
+// what it returns. calls to undefined functions go to the built-in host ones
+// (see host.h)
+int run_jit(ObjectFile const* obj);
+
+#endif // NNA774_KONOHA_JIT_H
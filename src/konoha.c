@@ -1,22 +1,39 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include "arena.h"
 #include "ast.h"
+#include "bytecode.h"
 #include "emit.h"
+#include "fold.h"
+#include "interp.h"
+#include "jit.h"
+#include "lower.h"
+#include "pass.h"
 #include "tokenize.h"
+#include "vm.h"
 
 enum Mode {
   TOKENIZE,
   AST,
   DUMP,
+  IR,
   EMIT,
+  RUN,
+  INTERPRET,
+  BYTECODE,
+  EXECUTE,
 };
 
 int main(int argc, char** argv) {
   int opt;
   enum Mode mode = EMIT;
-  FILE* infile = stdin;
+  char const* inpath = NULL;
   FILE* outfile = stdout;
-  while ((opt = getopt(argc, argv, "tado:")) != -1) {
+  EmitOption option = { false, false, false, false, false, false };
+  PassOption pass_option = { 0, false, 20 };
+  while ((opt = getopt(argc, argv, "taidgvcrebxo:O:f:")) != -1) {
     switch (opt) {
     case 't':
       mode = TOKENIZE;
@@ -24,9 +41,45 @@ int main(int argc, char** argv) {
     case 'a':
       mode = AST;
       break;
+    case 'i':
+      mode = IR;
+      break;
     case 'd':
       mode = DUMP;
       break;
+    case 'g':
+      option.ir_comment = true;
+      break;
+    case 'v':
+      pass_option.report = true;
+      break;
+    case 'c':
+      option.object = true;
+      break;
+    case 'r':
+      mode = RUN;
+      break;
+    case 'e':
+      mode = INTERPRET;
+      break;
+    case 'b':
+      mode = BYTECODE;
+      break;
+    case 'x':
+      mode = EXECUTE;
+      break;
+    case 'O':
+      pass_option.level = atoi(optarg);
+      break;
+    case 'f':
+      if(strcmp(optarg, "omit-frame-pointer") == 0) {
+        option.omit_frame_pointer = true;
+      } else if(strncmp(optarg, "inline-limit=", 13) == 0) {
+        pass_option.inline_limit = atoi(optarg + 13);
+      } else {
+        warn("unknown option: -f%s\n", optarg);
+      }
+      break;
     case 'o':
       outfile = fopen(optarg, "w+");
       assert(outfile != NULL);
@@ -41,20 +94,30 @@ int main(int argc, char** argv) {
     if(argc - optind > 2) {
       warn("now, only one src file acceptable\n");
     }
-    infile = fopen(argv[optind], "r");
-    assert(infile != NULL);
+    inpath = argv[optind];
   }
 
-  INTRUSIVE_LIST_OF(Token) ts = tokenize(infile);
-  fclose(infile);
+  option.tail_calls = pass_option.level >= 1;
+  option.peephole = pass_option.level >= 1;
+  option.peephole_report = pass_option.report;
+
+  Source* const src = inpath != NULL ? map_Source(inpath) : read_Source(stdin);
+  assert(src != NULL);
+  if(mode == EXECUTE) {
+    // the input is a .kbc file
+    return run_bytecode(src->top, Source_length(src));
+  }
+  Tokens const ts = tokenize(src);
   if(mode == TOKENIZE) {
-    printf("col: %d\n", list_of_Token_length(ts));
+    printf("col: %d\n", Tokens_length(ts));
     print_Tokens(ts);
     return 0;
   }
 
   Env* const env = new_Env();
   Ast* const ast = make_ast(env, ts);
+  // names are interned and the source stays mapped, so tokens are garbage now
+  release_region(TOKEN_REGION);
   if (mode == AST) {
     print_ast(ast);
   } else if (mode == DUMP) {
@@ -62,9 +125,24 @@ int main(int argc, char** argv) {
     print_ast(ast);
     printf("\nenv:\n");
     print_env(env);
+  } else if (mode == INTERPRET) {
+    // before fold_ast, so it checks the folding too
+    return interpret(ast);
   } else {
-    emit(outfile, ast, env);
-    fclose(outfile);
+    fold_ast(ast);
+    IrProgram* const ir = lower(ast);
+    optimize(ir, &pass_option);
+    if(mode == IR) {
+      print_IrProgram(ir);
+    } else if(mode == RUN) {
+      return run_jit(emit_object(ir, &option));
+    } else if(mode == BYTECODE) {
+      emit_bytecode(outfile, ir, &option);
+      fclose(outfile);
+    } else {
+      emit(outfile, ir, &option);
+      fclose(outfile);
+    }
   }
 
   return 0;
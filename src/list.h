@@ -6,6 +6,13 @@
     Type* next;\
   } _hook;
 
+// hook for lists which need O(1) remove/insert_after(see DEFINE_INTRUSIVE_DLIST)
+#define INTRUSIVE_DLIST_HOOK(Type) \
+  struct {\
+    Type* next;\
+    Type* prev;\
+  } _hook;
+
 #define INTRUSIVE_LIST_TYPE(Type) \
   struct CONCAT(_list_of_, Type)
 
@@ -16,6 +23,7 @@
   INTRUSIVE_LIST_TYPE(Type) {\
     int count;\
     Type* head;\
+    Type* tail;\
   };\
 \
   INTRUSIVE_LIST_OF(Type) CONCAT(new_list_of_, Type)();\
@@ -27,16 +35,26 @@
   Type* CONCAT3(list_of_, Type, _pop)(INTRUSIVE_LIST_OF(Type));\
   void CONCAT3(list_of_, Type, _push)(INTRUSIVE_LIST_OF(Type), Type*);\
 
-#define USE_INTRUSIVE_LIST(Type) \
+#define DEFINE_INTRUSIVE_DLIST(Type) \
+  DEFINE_INTRUSIVE_LIST(Type)\
+  void CONCAT3(list_of_, Type, _remove)(INTRUSIVE_LIST_OF(Type), Type*);\
+  void CONCAT3(list_of_, Type, _insert_after)(INTRUSIVE_LIST_OF(Type), Type*, Type*);\
+
+#define _LIST_NO_PREV(node, prev_node)
+#define _LIST_SET_PREV(node, prev_node) (node)->_hook.prev = (prev_node)
+
+#define _USE_INTRUSIVE_LIST_IMPL(Type, SET_PREV) \
   INTRUSIVE_LIST_OF(Type) CONCAT(new_list_of_, Type)() {\
     INTRUSIVE_LIST_OF(Type) l = malloc(sizeof(INTRUSIVE_LIST_TYPE(Type)));\
     l->count = 0;\
     l->head = NULL;\
+    l->tail = NULL;\
     return l;\
   }\
 \
   void CONCAT3(init_, Type, _hook)(Type* t) {\
     t->_hook.next = NULL;\
+    SET_PREV(t, NULL);\
   }\
 \
   void CONCAT3(list_of_, Type, _append)(INTRUSIVE_LIST_OF(Type) l, Type* app) {\
@@ -45,17 +63,13 @@
 \
     l->count++;\
     app->_hook.next = NULL;\
-    Type* v = l->head;\
-    if (v == NULL) {\
+    SET_PREV(app, l->tail);\
+    if (l->tail == NULL) {\
       l->head = app;\
-      return;\
+    } else {\
+      l->tail->_hook.next = app;\
     }\
-    Type* pre;\
-    while(v != NULL) {\
-      pre = v;\
-      v = v->_hook.next;\
-    }\
-    pre->_hook.next = app;\
+    l->tail = app;\
   }\
 \
   int CONCAT3(list_of_, Type, _length)(INTRUSIVE_LIST_OF(Type) l) {\
@@ -83,15 +97,66 @@
     Type* t = l->head;\
     l->count--;\
     l->head = t->_hook.next;\
+    if(l->head == NULL) {\
+      l->tail = NULL;\
+    } else {\
+      SET_PREV(l->head, NULL);\
+    }\
     t->_hook.next = NULL;\
+    SET_PREV(t, NULL);\
     return t;\
 }\
   void CONCAT3(list_of_, Type, _push)(INTRUSIVE_LIST_OF(Type) l, Type* v) {\
     assert(l != NULL);\
     l->count++;\
     v->_hook.next = l->head;\
+    SET_PREV(v, NULL);\
+    if(l->head == NULL) {\
+      l->tail = v;\
+    } else {\
+      SET_PREV(l->head, v);\
+    }\
     l->head = v;\
   }\
 
+#define USE_INTRUSIVE_LIST(Type) \
+  _USE_INTRUSIVE_LIST_IMPL(Type, _LIST_NO_PREV)
+
+#define USE_INTRUSIVE_DLIST(Type) \
+  _USE_INTRUSIVE_LIST_IMPL(Type, _LIST_SET_PREV)\
+\
+  void CONCAT3(list_of_, Type, _remove)(INTRUSIVE_LIST_OF(Type) l, Type* t) {\
+    assert(l != NULL);\
+    assert(t != NULL);\
+    l->count--;\
+    if(t->_hook.prev == NULL) {\
+      l->head = t->_hook.next;\
+    } else {\
+      t->_hook.prev->_hook.next = t->_hook.next;\
+    }\
+    if(t->_hook.next == NULL) {\
+      l->tail = t->_hook.prev;\
+    } else {\
+      t->_hook.next->_hook.prev = t->_hook.prev;\
+    }\
+    t->_hook.next = NULL;\
+    t->_hook.prev = NULL;\
+  }\
+\
+  void CONCAT3(list_of_, Type, _insert_after)(INTRUSIVE_LIST_OF(Type) l, Type* pos, Type* t) {\
+    assert(l != NULL);\
+    assert(pos != NULL);\
+    assert(t != NULL);\
+    l->count++;\
+    t->_hook.prev = pos;\
+    t->_hook.next = pos->_hook.next;\
+    if(pos->_hook.next == NULL) {\
+      l->tail = t;\
+    } else {\
+      pos->_hook.next->_hook.prev = t;\
+    }\
+    pos->_hook.next = t;\
+  }\
+
 #define FOREACH(Type, list, val) \
   for(Type* val = list->head; val != NULL; val = val->_hook.next)
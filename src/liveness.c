@@ -0,0 +1,67 @@
+#include "arena.h"
+#include "liveness.h"
+
+Liveness* compute_Liveness(IrFunc const* f) {
+  int const n = f->block_count;
+  Liveness* const l = region_alloc(CODEGEN_REGION, sizeof(Liveness));
+  l->block_count = n;
+  l->live_in = region_alloc(CODEGEN_REGION, sizeof(BitSet*) * (n + 1));
+  l->live_out = region_alloc(CODEGEN_REGION, sizeof(BitSet*) * (n + 1));
+  BitSet** const uses = region_alloc(CODEGEN_REGION, sizeof(BitSet*) * (n + 1));
+  BitSet** const defs = region_alloc(CODEGEN_REGION, sizeof(BitSet*) * (n + 1));
+
+  for(int i = 0; i < n; ++i) {
+    l->live_in[i] = new_BitSet(f->vreg_count);
+    l->live_out[i] = new_BitSet(f->vreg_count);
+    uses[i] = new_BitSet(f->vreg_count);
+    defs[i] = new_BitSet(f->vreg_count);
+  }
+  // upward exposed uses and defs of each block.
+  // a phi reads its arg at the end of the predecessor, not in its own block
+  for(int i = 0; i < n; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      IrInst const* const inst = &b->insts[j];
+      if(inst->op == IR_PHI) {
+        for(int k = 0; k < inst->phi.argc; ++k) {
+          IrPhiArg const* const arg = &f->phi_args[inst->phi.args + k];
+          BitSet_add(l->live_out[arg->block], arg->vreg);
+        }
+        BitSet_add(defs[i], inst->dst);
+        continue;
+      }
+      for(int k = 0; k < IrInst_use_count(inst); ++k) {
+        Vreg const v = IrInst_use(f, inst, k);
+        if(!BitSet_has(defs[i], v)) {
+          BitSet_add(uses[i], v);
+        }
+      }
+      if(inst->dst != NO_VREG) {
+        BitSet_add(defs[i], inst->dst);
+      }
+    }
+  }
+
+  // in = uses | (out - defs). blocks are mostly laid out forward, so go backward
+  BitSet* const tmp = new_BitSet(f->vreg_count);
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(int i = n - 1; i >= 0; --i) {
+      int succ[2];
+      int const succ_count = IrBlock_successors(&f->blocks[i], succ);
+      for(int j = 0; j < succ_count; ++j) {
+        BitSet_union(l->live_out[i], l->live_in[succ[j]]);
+      }
+      BitSet_copy(tmp, l->live_out[i]);
+      for(int w = 0; w < BitSet_words(tmp->size); ++w) {
+        tmp->words[w] &= ~defs[i]->words[w];
+      }
+      BitSet_union(tmp, uses[i]);
+      if(BitSet_union(l->live_in[i], tmp)) {
+        changed = true;
+      }
+    }
+  }
+  return l;
+}
@@ -0,0 +1,19 @@
+#ifndef NNA774_KONOHA_LIVENESS_H
+#define NNA774_KONOHA_LIVENESS_H
+
+#include "bitset.h"
+#include "ir.h"
+
+// vregs live at the entry/exit of each block(backward dataflow)
+struct Liveness;
+typedef struct Liveness Liveness;
+
+struct Liveness {
+  int block_count;
+  BitSet** live_in;
+  BitSet** live_out;
+};
+
+Liveness* compute_Liveness(IrFunc const*);
+
+#endif // NNA774_KONOHA_LIVENESS_H
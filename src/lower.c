@@ -0,0 +1,272 @@
+#include <string.h>
+#include "arena.h"
+#include "lower.h"
+
+struct Lowerer;
+typedef struct Lowerer Lowerer;
+
+struct Lowerer {
+  IrFunc* func;
+  int cur; // block appended to
+  // blocks in the order they are started, which becomes the layout
+  int* order;
+  int order_count;
+  int order_capacity;
+};
+
+void start_block(Lowerer* l, int block) {
+  if(l->order_count == l->order_capacity) {
+    int const capacity = l->order_capacity * 2;
+    int* const order = region_alloc(CODEGEN_REGION, sizeof(int) * capacity);
+    memcpy(order, l->order, sizeof(int) * l->order_count);
+    l->order = order;
+    l->order_capacity = capacity;
+  }
+  l->cur = block;
+  l->order[l->order_count++] = block;
+}
+
+// starts a fresh block unless the current one is still open
+void ensure_open_block(Lowerer* l) {
+  IrBlock const* const b = &l->func->blocks[l->cur];
+  if(b->count != 0 && IrOp_is_terminator(b->insts[b->count - 1].op)) {
+    start_block(l, new_IrBlock(l->func));
+  }
+}
+
+IrInst* append(Lowerer* l, IrOp op) {
+  ensure_open_block(l);
+  return append_IrInst(l->func, l->cur, op);
+}
+
+void append_jmp(Lowerer* l, int target) {
+  IrInst* const inst = append(l, IR_JMP);
+  inst->target[0] = target;
+}
+
+Vreg lower_expr(Lowerer* l, Ast const* ast);
+void lower_statement(Lowerer* l, Statement const* s);
+
+IrOp IrOp_from_TokenType(TokenType t) {
+  switch(t) {
+  case OP_PLUS_T:
+    return IR_ADD;
+  case OP_MINUS_T:
+    return IR_SUB;
+  case OP_MULTI_T:
+    return IR_MUL;
+  case OP_DIV_T:
+    return IR_DIV;
+  case OP_EQUAL_T:
+    return IR_EQ;
+  default:
+    warn("unknown token type(%s)\n", show_TokenType(t));
+    return IR_ADD;
+  }
+}
+
+Vreg append_unary(Lowerer* l, IrOp op, Vreg a, int imm) {
+  IrInst* const inst = append(l, op);
+  inst->dst = new_Vreg(l->func);
+  inst->a = a;
+  inst->imm = imm;
+  return inst->dst;
+}
+
+// k if n is 2^k(k >= 1), otherwise -1
+int power_of_two(int n) {
+  if(n <= 1 || (n & (n - 1)) != 0) {
+    return -1;
+  }
+  int k = 0;
+  while(n != 1) {
+    n >>= 1;
+    ++k;
+  }
+  return k;
+}
+
+// a / 2^k rounding toward zero: negative a gets 2^k - 1 added before the shift
+Vreg lower_div_by_power_of_two(Lowerer* l, Vreg a, int k) {
+  Vreg const sign = k == 1 ? a : append_unary(l, IR_SAR, a, 31);
+  Vreg const bias = append_unary(l, IR_SHR, sign, 32 - k);
+  IrInst* const inst = append(l, IR_ADD);
+  inst->dst = new_Vreg(l->func);
+  inst->a = a;
+  inst->b = bias;
+  return append_unary(l, IR_SAR, inst->dst, k);
+}
+
+Vreg lower_bi_op(Lowerer* l, Ast const* ast) {
+  TokenType const t = ast->bi_op.op_type;
+  if(t == OP_ASSIGN_T) {
+    Var const* const v = ast->bi_op.lhs->var;
+    Vreg const val = lower_expr(l, ast->bi_op.rhs);
+    IrInst* const inst = append(l, IR_MOV);
+    inst->dst = v->id;
+    inst->a = val;
+    return v->id;
+  }
+  Ast const* const lhs = ast->bi_op.lhs;
+  Ast const* const rhs = ast->bi_op.rhs;
+  // fold_ast leaves negation as 0-x
+  if(t == OP_MINUS_T && lhs->type == AST_INT && lhs->int_val == 0) {
+    return append_unary(l, IR_NEG, lower_expr(l, rhs), 0);
+  }
+  int const k = rhs->type == AST_INT ? power_of_two(rhs->int_val) : -1;
+  if(k > 0 && t == OP_MULTI_T) {
+    return append_unary(l, IR_SHL, lower_expr(l, lhs), k);
+  }
+  if(k > 0 && t == OP_DIV_T) {
+    return lower_div_by_power_of_two(l, lower_expr(l, lhs), k);
+  }
+  Vreg const a = lower_expr(l, ast->bi_op.lhs);
+  Vreg const b = lower_expr(l, ast->bi_op.rhs);
+  IrInst* const inst = append(l, IrOp_from_TokenType(t));
+  inst->dst = new_Vreg(l->func);
+  inst->a = a;
+  inst->b = b;
+  return inst->dst;
+}
+
+Vreg lower_funcall(Lowerer* l, FunCall const* f) {
+  Vreg* const args = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (f->argc + 1));
+  for(int i = 0; i < f->argc; ++i) {
+    args[i] = lower_expr(l, f->args[i]);
+  }
+  int const first = append_call_args(l->func, args, f->argc);
+  IrInst* const inst = append(l, IR_CALL);
+  inst->dst = new_Vreg(l->func);
+  inst->name = f->name;
+  inst->call.args = first;
+  inst->call.argc = f->argc;
+  return inst->dst;
+}
+
+Vreg lower_expr(Lowerer* l, Ast const* ast) {
+  switch(ast->type) {
+  case AST_INT:
+  {
+    IrInst* const inst = append(l, IR_CONST);
+    inst->dst = new_Vreg(l->func);
+    inst->imm = ast->int_val;
+    return inst->dst;
+  }
+  case AST_BI_OP:
+    return lower_bi_op(l, ast);
+  case AST_SYM:
+    assert(ast->var->id >= 0);
+    return ast->var->id;
+  case AST_FUNCALL:
+    return lower_funcall(l, ast->funcall);
+  case AST_SYM_DEFINE:
+    ast->var->id = new_Vreg(l->func);
+    return NO_VREG;
+  case AST_STATEMENT:
+    lower_statement(l, ast->statement);
+    return NO_VREG;
+  case AST_STATEMENTS:
+    FOREACH(Statement, ast->statements->val, s) {
+      lower_statement(l, s);
+    }
+    return NO_VREG;
+  case AST_BLOCK:
+    return lower_expr(l, ast->block->val);
+  case AST_EMPTY:
+    return NO_VREG;
+  default:
+    warn("never come!!!(type: %s)\n", show_AstType(ast->type));
+    return NO_VREG;
+  }
+}
+
+void lower_statement(Lowerer* l, Statement const* s) {
+  switch(s->type) {
+  case NORMAL_STATEMENT:
+    lower_expr(l, s->val);
+    break;
+  case RETURN_STATEMENT:
+  {
+    Vreg const v = lower_expr(l, s->val);
+    IrInst* const inst = append(l, IR_RET);
+    inst->a = v;
+    break;
+  }
+  case IF_STATEMENT:
+  {
+    Vreg const cond = lower_expr(l, s->if_val.cond);
+    int const then_b = new_IrBlock(l->func);
+    int const else_b = s->if_val.else_body != NULL ? new_IrBlock(l->func) : -1;
+    int const join = new_IrBlock(l->func);
+    IrInst* const br = append(l, IR_BR);
+    br->a = cond;
+    br->target[0] = then_b;
+    br->target[1] = else_b >= 0 ? else_b : join;
+    start_block(l, then_b);
+    lower_statement(l, s->if_val.body);
+    append_jmp(l, join);
+    if(else_b >= 0) {
+      start_block(l, else_b);
+      lower_statement(l, s->if_val.else_body);
+      append_jmp(l, join);
+    }
+    start_block(l, join);
+    break;
+  }
+  case WHILE_STATEMENT:
+  {
+    // the test is placed after the body, so an iteration takes one branch
+    int const body = new_IrBlock(l->func);
+    int const test = new_IrBlock(l->func);
+    int const exit = new_IrBlock(l->func);
+    append_jmp(l, test);
+    start_block(l, body);
+    lower_statement(l, s->while_val.body);
+    append_jmp(l, test);
+    start_block(l, test);
+    Vreg const cond = lower_expr(l, s->while_val.cond);
+    IrInst* const br = append(l, IR_BR);
+    br->a = cond;
+    br->target[0] = body;
+    br->target[1] = exit;
+    start_block(l, exit);
+    break;
+  }
+  default:
+    warn("unimpled statement type(%s)\n", show_StatementType(s->type));
+  }
+}
+
+void lower_func(IrProgram* p, FunDef const* def) {
+  Lowerer lowerer;
+  Lowerer* const l = &lowerer;
+  l->func = add_IrFunc(p, def->name, def->type.argc);
+  l->order_capacity = 16;
+  l->order = region_alloc(CODEGEN_REGION, sizeof(int) * l->order_capacity);
+  l->order_count = 0;
+  start_block(l, new_IrBlock(l->func));
+  for(int i = 0; i < def->type.argc; ++i) {
+    def->args[i]->id = new_Vreg(l->func);
+    IrInst* const inst = append(l, IR_PARAM);
+    inst->dst = def->args[i]->id;
+    inst->imm = i;
+  }
+  lower_expr(l, def->body);
+  // falling off the end
+  IrBlock const* const last = &l->func->blocks[l->cur];
+  if(last->count == 0 || !IrOp_is_terminator(last->insts[last->count - 1].op)) {
+    append(l, IR_RET);
+  }
+  reorder_IrBlocks(l->func, l->order, l->order_count);
+}
+
+IrProgram* lower(Ast const* ast) {
+  assert(ast != NULL);
+  assert(ast->type == AST_GLOBAL);
+  IrProgram* const p = new_IrProgram();
+  FOREACH(Ast, ast->global->list, s) {
+    assert(s->type == AST_FUNDEFIN);
+    lower_func(p, s->fundef);
+  }
+  return p;
+}
@@ -0,0 +1,10 @@
+#ifndef NNA774_KONOHA_LOWER_H
+#define NNA774_KONOHA_LOWER_H
+
+#include "ast.h"
+#include "ir.h"
+
+// Ast(AST_GLOBAL) -> IR. every Var becomes one vreg(Var.id)
+IrProgram* lower(Ast const*);
+
+#endif // NNA774_KONOHA_LOWER_H
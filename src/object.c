@@ -0,0 +1,186 @@
+#include <elf.h>
+#include <stdint.h>
+#include "arena.h"
+#include "object.h"
+
+ObjectFile* new_ObjectFile() {
+  ObjectFile* const obj = region_alloc(CODEGEN_REGION, sizeof(ObjectFile));
+  obj->text = new_buffer_Writer();
+  obj->symbols = NULL;
+  obj->symbol_count = 0;
+  obj->symbol_capacity = 0;
+  obj->symbol_indices = new_SymbolMap();
+  obj->relocations = NULL;
+  obj->relocation_count = 0;
+  obj->relocation_capacity = 0;
+  return obj;
+}
+
+int ObjectFile_symbol(ObjectFile* obj, Symbol name) {
+  intptr_t const found = (intptr_t)SymbolMap_find(obj->symbol_indices, name);
+  if(found != 0) {
+    return found - 1;
+  }
+  GROW_ARRAY(ObjectSymbol, obj->symbols, obj->symbol_count, obj->symbol_capacity, 16);
+  ObjectSymbol* const s = &obj->symbols[obj->symbol_count];
+  s->name = name;
+  s->defined = false;
+  s->offset = 0;
+  s->size = 0;
+  SymbolMap_insert(obj->symbol_indices, name, (void*)(intptr_t)(obj->symbol_count + 1));
+  return obj->symbol_count++;
+}
+
+void define_ObjectSymbol(ObjectFile* obj, Symbol name, int offset, int size) {
+  int const index = ObjectFile_symbol(obj, name); // may move symbols
+  ObjectSymbol* const s = &obj->symbols[index];
+  if(s->defined) {
+    warn("%s is defined twice\n", name);
+  }
+  s->defined = true;
+  s->offset = offset;
+  s->size = size;
+}
+
+void add_Relocation(ObjectFile* obj, int offset, Symbol name, int argc) {
+  int const symbol = ObjectFile_symbol(obj, name);
+  GROW_ARRAY(Relocation, obj->relocations, obj->relocation_count, obj->relocation_capacity, 16);
+  Relocation* const r = &obj->relocations[obj->relocation_count++];
+  r->offset = offset;
+  r->symbol = symbol;
+  r->argc = argc;
+}
+
+// section header indices
+enum {
+  TEXT_SECTION = 1,
+  SYMTAB_SECTION,
+  STRTAB_SECTION,
+  RELA_TEXT_SECTION,
+  SHSTRTAB_SECTION,
+  NOTE_GNU_STACK_SECTION, // empty. says the stack needn't be executable
+  NUMBER_OF_SECTIONS,
+};
+
+// the names in .shstrtab, each starting at the offset of its section's
+char const SECTION_NAMES[] = "\0.text\0.symtab\0.strtab\0.rela.text\0.shstrtab\0.note.GNU-stack";
+int const SECTION_NAME_OFFSETS[] = { 0, 1, 7, 15, 23, 34, 44 };
+
+size_t align_up(size_t n, size_t align) {
+  return (n + align - 1) / align * align;
+}
+
+// writes zeros up to offset
+void pad_to(Writer* w, size_t* pos, size_t offset) {
+  while(*pos < offset) {
+    write_char(w, '\0');
+    ++*pos;
+  }
+}
+
+void put(Writer* w, size_t* pos, void const* p, size_t n) {
+  write_bytes(w, p, n);
+  *pos += n;
+}
+
+Elf64_Shdr section_header(int index, Elf64_Word type, Elf64_Xword flags, size_t offset, size_t size) {
+  Elf64_Shdr h;
+  memset(&h, 0, sizeof(h));
+  h.sh_name = SECTION_NAME_OFFSETS[index];
+  h.sh_type = type;
+  h.sh_flags = flags;
+  h.sh_offset = offset;
+  h.sh_size = size;
+  h.sh_addralign = 1;
+  return h;
+}
+
+// the sections follow the ELF header in order, then their headers
+void write_ObjectFile(Writer* w, ObjectFile const* obj) {
+  Writer* const strtab = new_buffer_Writer();
+  write_char(strtab, '\0');
+  int* const name_offsets = region_alloc(CODEGEN_REGION, sizeof(int) * (obj->symbol_count + 1));
+  for(int i = 0; i < obj->symbol_count; ++i) {
+    name_offsets[i] = strtab->length;
+    write_bytes(strtab, obj->symbols[i].name, strlen(obj->symbols[i].name) + 1);
+  }
+
+  // symbol 0 is the null one. all the others are global
+  size_t const symbol_count = obj->symbol_count + 1;
+  size_t const text_offset = align_up(sizeof(Elf64_Ehdr), 16);
+  size_t const symtab_offset = align_up(text_offset + obj->text->length, 8);
+  size_t const strtab_offset = symtab_offset + sizeof(Elf64_Sym) * symbol_count;
+  size_t const rela_offset = align_up(strtab_offset + strtab->length, 8);
+  size_t const shstrtab_offset = rela_offset + sizeof(Elf64_Rela) * obj->relocation_count;
+  size_t const section_headers_offset = align_up(shstrtab_offset + sizeof(SECTION_NAMES), 8);
+
+  Elf64_Ehdr header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  header.e_type = ET_REL;
+  header.e_machine = EM_X86_64;
+  header.e_version = EV_CURRENT;
+  header.e_shoff = section_headers_offset;
+  header.e_ehsize = sizeof(Elf64_Ehdr);
+  header.e_shentsize = sizeof(Elf64_Shdr);
+  header.e_shnum = NUMBER_OF_SECTIONS;
+  header.e_shstrndx = SHSTRTAB_SECTION;
+
+  size_t pos = 0;
+  put(w, &pos, &header, sizeof(header));
+  pad_to(w, &pos, text_offset);
+  put(w, &pos, obj->text->buf, obj->text->length);
+
+  pad_to(w, &pos, symtab_offset);
+  Elf64_Sym sym;
+  memset(&sym, 0, sizeof(sym));
+  put(w, &pos, &sym, sizeof(sym));
+  for(int i = 0; i < obj->symbol_count; ++i) {
+    ObjectSymbol const* const s = &obj->symbols[i];
+    sym.st_name = name_offsets[i];
+    sym.st_info = ELF64_ST_INFO(STB_GLOBAL, s->defined ? STT_FUNC : STT_NOTYPE);
+    sym.st_other = STV_DEFAULT;
+    sym.st_shndx = s->defined ? TEXT_SECTION : SHN_UNDEF;
+    sym.st_value = s->offset;
+    sym.st_size = s->size;
+    put(w, &pos, &sym, sizeof(sym));
+  }
+  put(w, &pos, strtab->buf, strtab->length);
+
+  pad_to(w, &pos, rela_offset);
+  for(int i = 0; i < obj->relocation_count; ++i) {
+    Relocation const* const r = &obj->relocations[i];
+    Elf64_Rela rela;
+    rela.r_offset = r->offset;
+    // symbol indices are shifted by the null one
+    rela.r_info = ELF64_R_INFO(r->symbol + 1, R_X86_64_PLT32);
+    // the target is relative to the end of the rel32
+    rela.r_addend = -4;
+    put(w, &pos, &rela, sizeof(rela));
+  }
+  put(w, &pos, SECTION_NAMES, sizeof(SECTION_NAMES));
+
+  pad_to(w, &pos, section_headers_offset);
+  Elf64_Shdr headers[NUMBER_OF_SECTIONS];
+  memset(&headers[0], 0, sizeof(Elf64_Shdr));
+  headers[TEXT_SECTION] = section_header(TEXT_SECTION, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_offset, obj->text->length);
+  headers[TEXT_SECTION].sh_addralign = 16;
+  headers[SYMTAB_SECTION] = section_header(SYMTAB_SECTION, SHT_SYMTAB, 0, symtab_offset, sizeof(Elf64_Sym) * symbol_count);
+  headers[SYMTAB_SECTION].sh_link = STRTAB_SECTION;
+  headers[SYMTAB_SECTION].sh_info = 1; // the first global one
+  headers[SYMTAB_SECTION].sh_entsize = sizeof(Elf64_Sym);
+  headers[SYMTAB_SECTION].sh_addralign = 8;
+  headers[STRTAB_SECTION] = section_header(STRTAB_SECTION, SHT_STRTAB, 0, strtab_offset, strtab->length);
+  headers[RELA_TEXT_SECTION] = section_header(RELA_TEXT_SECTION, SHT_RELA, SHF_INFO_LINK, rela_offset, sizeof(Elf64_Rela) * obj->relocation_count);
+  headers[RELA_TEXT_SECTION].sh_link = SYMTAB_SECTION;
+  headers[RELA_TEXT_SECTION].sh_info = TEXT_SECTION;
+  headers[RELA_TEXT_SECTION].sh_entsize = sizeof(Elf64_Rela);
+  headers[RELA_TEXT_SECTION].sh_addralign = 8;
+  headers[SHSTRTAB_SECTION] = section_header(SHSTRTAB_SECTION, SHT_STRTAB, 0, shstrtab_offset, sizeof(SECTION_NAMES));
+  headers[NOTE_GNU_STACK_SECTION] = section_header(NOTE_GNU_STACK_SECTION, SHT_PROGBITS, 0, section_headers_offset, 0);
+  put(w, &pos, headers, sizeof(headers));
+}
@@ -0,0 +1,48 @@
+#ifndef NNA774_KONOHA_OBJECT_H
+#define NNA774_KONOHA_OBJECT_H
+
+#include "symbol.h"
+#include "writer.h"
+
+// relocatable ELF64 object for x86-64: the code of every function in .text,
+// a global symbol for each of them and for each function they call
+struct ObjectSymbol;
+typedef struct ObjectSymbol ObjectSymbol;
+struct Relocation;
+typedef struct Relocation Relocation;
+struct ObjectFile;
+typedef struct ObjectFile ObjectFile;
+
+struct ObjectSymbol {
+  Symbol name;
+  bool defined; // in .text. undefined ones are left to the linker
+  int offset;
+  int size;
+};
+
+// the rel32 at offset in .text becomes the distance from its end to symbol
+struct Relocation {
+  int offset;
+  int symbol; // index into symbols
+  int argc; // of the call. -r checks it against host functions
+};
+
+struct ObjectFile {
+  Writer* text; // contents of .text
+  ObjectSymbol* symbols;
+  int symbol_count;
+  int symbol_capacity;
+  SymbolMap* symbol_indices; // name -> index into symbols + 1
+  Relocation* relocations;
+  int relocation_count;
+  int relocation_capacity;
+};
+
+ObjectFile* new_ObjectFile();
+// the index of name in symbols, added(undefined) if it isn't there
+int ObjectFile_symbol(ObjectFile*, Symbol name);
+void define_ObjectSymbol(ObjectFile*, Symbol name, int offset, int size);
+void add_Relocation(ObjectFile*, int offset, Symbol name, int argc);
+void write_ObjectFile(Writer*, ObjectFile const*);
+
+#endif // NNA774_KONOHA_OBJECT_H
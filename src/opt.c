@@ -0,0 +1,147 @@
+#include "arena.h"
+#include "bitset.h"
+#include "opt.h"
+
+Vreg resolve_alias(Vreg* alias, Vreg v) {
+  Vreg root = v;
+  while(alias[root] != root) {
+    root = alias[root];
+  }
+  while(alias[v] != root) {
+    Vreg const next = alias[v];
+    alias[v] = root;
+    v = next;
+  }
+  return root;
+}
+
+// the only value a phi can take besides itself, or NO_VREG
+Vreg trivial_phi_value(IrFunc const* f, Vreg* alias, IrInst const* phi) {
+  Vreg value = NO_VREG;
+  for(int i = 0; i < phi->phi.argc; ++i) {
+    Vreg const v = resolve_alias(alias, f->phi_args[phi->phi.args + i].vreg);
+    if(v == phi->dst || v == value) {
+      continue;
+    }
+    if(value != NO_VREG) {
+      return NO_VREG;
+    }
+    value = v;
+  }
+  return value;
+}
+
+void propagate_copies(IrFunc* f) {
+  Vreg* const alias = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (f->vreg_count + 1));
+  for(int v = 0; v < f->vreg_count; ++v) {
+    alias[v] = v;
+  }
+  // a phi becomes trivial once the phis it reads are, so repeat until nothing changes
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(int i = 0; i < f->block_count; ++i) {
+      IrBlock const* const b = &f->blocks[i];
+      for(int j = 0; j < b->count; ++j) {
+        IrInst const* const inst = &b->insts[j];
+        if(inst->dst == NO_VREG || alias[inst->dst] != inst->dst) {
+          continue;
+        }
+        Vreg value = NO_VREG;
+        if(inst->op == IR_MOV) {
+          value = resolve_alias(alias, inst->a);
+        } else if(inst->op == IR_PHI) {
+          value = trivial_phi_value(f, alias, inst);
+        }
+        if(value != NO_VREG && value != inst->dst) {
+          alias[inst->dst] = value;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      IrInst* const inst = &b->insts[j];
+      if(inst->dst != NO_VREG && alias[inst->dst] != inst->dst) {
+        inst->op = IR_NOP;
+        inst->dst = NO_VREG;
+        continue;
+      }
+      for(int k = 0; k < IrInst_use_count(inst); ++k) {
+        Vreg* const use = IrInst_use_ref(f, inst, k);
+        *use = resolve_alias(alias, *use);
+      }
+    }
+    compact_IrBlock(b);
+  }
+}
+
+// must stay even when its dst is never read. div may trap
+bool has_side_effect(IrOp op) {
+  switch(op) {
+  case IR_CALL:
+  case IR_DIV:
+  case IR_JMP:
+  case IR_BR:
+  case IR_RET:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void mark_live(BitSet* live, Vreg* worklist, int* count, Vreg v) {
+  if(!BitSet_has(live, v)) {
+    BitSet_add(live, v);
+    worklist[(*count)++] = v;
+  }
+}
+
+void eliminate_dead_code(IrFunc* f) {
+  // the only definition of each vreg
+  IrInst const** const def = region_alloc(CODEGEN_REGION, sizeof(IrInst*) * (f->vreg_count + 1));
+  for(int v = 0; v < f->vreg_count; ++v) {
+    def[v] = NULL;
+  }
+  BitSet* const live = new_BitSet(f->vreg_count);
+  Vreg* const worklist = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (f->vreg_count + 1));
+  int count = 0;
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock const* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      IrInst const* const inst = &b->insts[j];
+      if(inst->dst != NO_VREG) {
+        def[inst->dst] = inst;
+      }
+      if(has_side_effect(inst->op)) {
+        for(int k = 0; k < IrInst_use_count(inst); ++k) {
+          mark_live(live, worklist, &count, IrInst_use(f, inst, k));
+        }
+      }
+    }
+  }
+  while(count != 0) {
+    IrInst const* const inst = def[worklist[--count]];
+    if(inst == NULL) {
+      continue;
+    }
+    for(int k = 0; k < IrInst_use_count(inst); ++k) {
+      mark_live(live, worklist, &count, IrInst_use(f, inst, k));
+    }
+  }
+
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock* const b = &f->blocks[i];
+    for(int j = 0; j < b->count; ++j) {
+      IrInst* const inst = &b->insts[j];
+      if(inst->dst != NO_VREG && !has_side_effect(inst->op) && !BitSet_has(live, inst->dst)) {
+        inst->op = IR_NOP;
+        inst->dst = NO_VREG;
+      }
+    }
+    compact_IrBlock(b);
+  }
+}
@@ -0,0 +1,14 @@
+#ifndef NNA774_KONOHA_OPT_H
+#define NNA774_KONOHA_OPT_H
+
+#include "ir.h"
+
+// optimization passes over SSA form
+
+// uses of `d = mov s` and of phis whose args are all the same read the source directly
+void propagate_copies(IrFunc*);
+// drops instructions whose results never reach a call, div, branch or ret.
+// dead stores to locals go with them, phi cycles included
+void eliminate_dead_code(IrFunc*);
+
+#endif // NNA774_KONOHA_OPT_H
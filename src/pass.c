@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <time.h>
+#include "cfg.h"
+#include "inline.h"
+#include "opt.h"
+#include "pass.h"
+#include "ssa.h"
+#include "tail.h"
+
+struct Pass;
+typedef struct Pass Pass;
+
+struct Pass {
+  char const* name;
+  int level; // runs at -O<level> and above
+  // one of them is set. run is called for every function
+  void (*run)(IrFunc*);
+  void (*run_program)(IrProgram*, PassOption const*);
+};
+
+void run_inline(IrProgram* p, PassOption const* option) {
+  inline_calls(p, option->inline_limit);
+}
+
+// in order. everything between "ssa" and "leave-ssa" works on SSA form
+Pass const PASSES[] = {
+  { "unreachable-blocks", 0, prune_unreachable_blocks, NULL },
+  { "inline", 2, NULL, run_inline },
+  { "tail-recursion", 1, eliminate_tail_recursion, NULL },
+  { "ssa", 1, build_ssa, NULL },
+  { "copy-propagation", 1, propagate_copies, NULL },
+  { "dead-code", 1, eliminate_dead_code, NULL },
+  { "leave-ssa", 1, leave_ssa, NULL },
+};
+int const NUMBER_OF_PASSES = sizeof(PASSES) / sizeof(*PASSES);
+
+struct IrSize;
+typedef struct IrSize IrSize;
+
+struct IrSize {
+  int insts;
+  int blocks;
+  int vregs;
+};
+
+IrSize IrProgram_size(IrProgram const* p) {
+  IrSize size = { 0, 0, 0 };
+  for(int i = 0; i < p->count; ++i) {
+    size.insts += IrFunc_inst_count(&p->funcs[i]);
+    size.blocks += p->funcs[i].block_count;
+    size.vregs += p->funcs[i].vreg_count;
+  }
+  return size;
+}
+
+double now_us() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+void optimize(IrProgram* p, PassOption const* option) {
+  if(option->report) {
+    fprintf(stderr, "%-20s %10s %16s %16s %16s\n", "pass", "time(us)", "insts", "blocks", "vregs");
+  }
+  double total = 0;
+  for(int i = 0; i < NUMBER_OF_PASSES; ++i) {
+    Pass const* const pass = &PASSES[i];
+    if(option->level < pass->level) {
+      continue;
+    }
+    IrSize const before = IrProgram_size(p);
+    double const start = now_us();
+    if(pass->run_program != NULL) {
+      pass->run_program(p, option);
+    } else {
+      for(int j = 0; j < p->count; ++j) {
+        pass->run(&p->funcs[j]);
+      }
+    }
+    double const elapsed = now_us() - start;
+    total += elapsed;
+    if(option->report) {
+      IrSize const after = IrProgram_size(p);
+      fprintf(
+        stderr,
+        "%-20s %10.1f %7d -> %-6d %7d -> %-6d %7d -> %-6d\n",
+        pass->name,
+        elapsed,
+        before.insts, after.insts,
+        before.blocks, after.blocks,
+        before.vregs, after.vregs
+      );
+    }
+  }
+  if(option->report) {
+    fprintf(stderr, "%-20s %10.1f\n", "total", total);
+  }
+}
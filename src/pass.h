@@ -0,0 +1,19 @@
+#ifndef NNA774_KONOHA_PASS_H
+#define NNA774_KONOHA_PASS_H
+
+#include "ir.h"
+
+struct PassOption;
+typedef struct PassOption PassOption;
+
+struct PassOption {
+  int level; // -O0, -O1, -O2
+  bool report; // -v: time and IR size of each pass to stderr
+  int inline_limit; // -finline-limit=<n>: largest callee inlined(-O2), in IR instructions
+};
+
+// runs the passes enabled at option->level over every function.
+// the result is out of SSA, ready for emit
+void optimize(IrProgram*, PassOption const*);
+
+#endif // NNA774_KONOHA_PASS_H
@@ -0,0 +1,269 @@
+#include "arena.h"
+#include "peephole.h"
+
+char const* const PEEPHOLE_PATTERN_NAMES[] = {
+  "store-load",
+  "immediate",
+  "redundant-move",
+  "dead-move",
+  "jump-to-next",
+};
+
+bool is_mov(X86Op op) {
+  return op == X86_MOVL || op == X86_MOVQ;
+}
+
+// %rsp and %rbp aren't tracked(see X86Inst_defs), so nothing moving them is touched
+bool is_frame_reg(Operand o) {
+  return o.type == REG_OPERAND && (o.val == RSP || o.val == RBP);
+}
+
+// control may enter or leave after these, so facts about registers end there
+bool ends_straight_line(X86Op op) {
+  return op == X86_LABEL || is_jump(op) || op == X86_RET || op == X86_TAIL;
+}
+
+// instructions reading src as 32 bits, which may be a register as well as a slot
+bool reads_src32(X86Op op) {
+  return op == X86_MOVL || op == X86_ADDL || op == X86_SUBL || op == X86_IMULL || op == X86_CMPL || op == X86_IDIVL;
+}
+
+// after `mov %r, slot` or `mov slot, %r` both hold the same value until either
+// changes, so reads of the slot in between read %r instead
+void forward_stores(X86Func* f, PeepholeStats* stats) {
+  for(int i = 0; i < f->count; ++i) {
+    X86Inst const* const first = &f->insts[i];
+    if(!is_mov(first->op)) {
+      continue;
+    }
+    Operand slot;
+    Operand reg;
+    if(first->src.type == REG_OPERAND && first->dst.type == SLOT_OPERAND) {
+      reg = first->src;
+      slot = first->dst;
+    } else if(first->src.type == SLOT_OPERAND && first->dst.type == REG_OPERAND) {
+      slot = first->src;
+      reg = first->dst;
+    } else {
+      continue;
+    }
+    for(int j = i + 1; j < f->count && !ends_straight_line(f->insts[j].op); ++j) {
+      X86Inst* const inst = &f->insts[j];
+      bool const same_size = inst->op == first->op || (first->op == X86_MOVL && reads_src32(inst->op));
+      if(same_size && same_operand(inst->src, slot)) {
+        ++stats->hits[STORE_LOAD];
+        if(is_mov(inst->op) && same_operand(inst->dst, reg)) {
+          inst->op = X86_NOP;
+          continue;
+        }
+        inst->src = reg;
+      }
+      if(first->op == X86_MOVL && inst->op == X86_CMPL && same_operand(inst->dst, slot)) {
+        ++stats->hits[STORE_LOAD];
+        inst->dst = reg;
+      }
+      if(X86Inst_defs(inst) & REG_BIT(reg.val) || same_operand(inst->dst, slot)) {
+        break;
+      }
+    }
+  }
+}
+
+// `mov %a, %b` and then `mov %b, %a` with neither changed in between
+void remove_moves_back(X86Func* f, PeepholeStats* stats) {
+  for(int i = 0; i < f->count; ++i) {
+    X86Inst const* const first = &f->insts[i];
+    if(!is_mov(first->op) || first->src.type != REG_OPERAND || first->dst.type != REG_OPERAND
+        || is_frame_reg(first->src) || is_frame_reg(first->dst)) {
+      continue;
+    }
+    unsigned const regs = REG_BIT(first->src.val) | REG_BIT(first->dst.val);
+    for(int j = i + 1; j < f->count && !ends_straight_line(f->insts[j].op); ++j) {
+      X86Inst* const inst = &f->insts[j];
+      if(inst->op == first->op && same_operand(inst->src, first->dst) && same_operand(inst->dst, first->src)) {
+        inst->op = X86_NOP;
+        ++stats->hits[REDUNDANT_MOVE];
+        continue;
+      }
+      if(X86Inst_defs(inst) & regs) {
+        break;
+      }
+    }
+  }
+}
+
+bool takes_immediate(X86Op op) {
+  return op == X86_MOVL || op == X86_ADDL || op == X86_SUBL || op == X86_IMULL || op == X86_CMPL;
+}
+
+// constants are materialized into registers first(IR_CONST has a vreg of its own).
+// reads of them become immediates, which mostly leaves the materialization dead
+void fold_immediates(X86Func* f, PeepholeStats* stats) {
+  unsigned known = 0; // REG_BITs of the registers holding value[r]
+  int value[NUMBER_OF_REGS];
+  for(int i = 0; i < f->count; ++i) {
+    X86Inst* const inst = &f->insts[i];
+    if(inst->op == X86_LABEL) {
+      known = 0;
+      continue;
+    }
+    if(takes_immediate(inst->op) && inst->src.type == REG_OPERAND && known & REG_BIT(inst->src.val)) {
+      inst->src = imm_operand(value[inst->src.val]);
+      ++stats->hits[IMMEDIATE];
+    }
+    bool const loads_imm = inst->op == X86_MOVL && inst->src.type == IMM_OPERAND && inst->dst.type == REG_OPERAND;
+    if(loads_imm && known & REG_BIT(inst->dst.val) && value[inst->dst.val] == inst->src.val) {
+      inst->op = X86_NOP;
+      ++stats->hits[REDUNDANT_MOVE];
+      continue;
+    }
+    if(is_mov(inst->op) && same_operand(inst->src, inst->dst)) {
+      inst->op = X86_NOP;
+      ++stats->hits[REDUNDANT_MOVE];
+      continue;
+    }
+    known &= ~X86Inst_defs(inst);
+    if(loads_imm) {
+      known |= REG_BIT(inst->dst.val);
+      value[inst->dst.val] = inst->src.val;
+    }
+  }
+}
+
+// index of each label's instruction, indexed by label - *base
+int* find_labels(X86Func const* f, int* base) {
+  int min = 0;
+  int max = -1;
+  for(int i = 0; i < f->count; ++i) {
+    if(f->insts[i].op == X86_LABEL) {
+      int const l = f->insts[i].label;
+      if(max < min) {
+        min = max = l;
+      }
+      min = l < min ? l : min;
+      max = l > max ? l : max;
+    }
+  }
+  int* const index = region_alloc(CODEGEN_REGION, sizeof(int) * (max - min + 2));
+  for(int i = 0; i < f->count; ++i) {
+    if(f->insts[i].op == X86_LABEL) {
+      index[f->insts[i].label - min] = i;
+    }
+  }
+  *base = min;
+  return index;
+}
+
+// registers live after each instruction
+unsigned* compute_live_out(X86Func const* f) {
+  int base;
+  int const* const labels = find_labels(f, &base);
+  unsigned* const live_in = region_alloc(CODEGEN_REGION, sizeof(unsigned) * (f->count + 1));
+  unsigned* const live_out = region_alloc(CODEGEN_REGION, sizeof(unsigned) * (f->count + 1));
+  for(int i = 0; i <= f->count; ++i) {
+    live_in[i] = 0;
+    live_out[i] = 0;
+  }
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(int i = f->count - 1; i >= 0; --i) {
+      X86Inst const* const inst = &f->insts[i];
+      unsigned out = 0;
+      if(is_jump(inst->op)) {
+        out |= live_in[labels[inst->label - base]];
+      }
+      if(inst->op != X86_JMP && inst->op != X86_RET && inst->op != X86_TAIL) {
+        out |= live_in[i + 1];
+      }
+      unsigned const in = X86Inst_uses(inst) | (out & ~X86Inst_defs(inst));
+      live_out[i] = out;
+      if(in != live_in[i]) {
+        live_in[i] = in;
+        changed = true;
+      }
+    }
+  }
+  return live_out;
+}
+
+void remove_dead_moves(X86Func* f, PeepholeStats* stats) {
+  bool removed = true;
+  while(removed) {
+    removed = false;
+    unsigned const* const live_out = compute_live_out(f);
+    for(int i = 0; i < f->count; ++i) {
+      X86Inst* const inst = &f->insts[i];
+      if(!is_mov(inst->op) || inst->dst.type != REG_OPERAND || is_frame_reg(inst->dst)) {
+        continue;
+      }
+      if(!(live_out[i] & REG_BIT(inst->dst.val))) {
+        inst->op = X86_NOP;
+        ++stats->hits[DEAD_MOVE];
+        removed = true;
+      }
+    }
+  }
+}
+
+// whether label is bound right after insts[i], before any other instruction
+bool is_next_label(X86Func const* f, int i, int label) {
+  for(int j = i + 1; j < f->count; ++j) {
+    X86Inst const* const inst = &f->insts[j];
+    if(inst->op == X86_LABEL && inst->label == label) {
+      return true;
+    }
+    if(inst->op != X86_LABEL && inst->op != X86_COMMENT && inst->op != X86_NOP) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// the next instruction after insts[i], skipping comments, or -1
+int next_inst(X86Func const* f, int i) {
+  for(int j = i + 1; j < f->count; ++j) {
+    if(f->insts[j].op != X86_COMMENT && f->insts[j].op != X86_NOP) {
+      return j;
+    }
+  }
+  return -1;
+}
+
+// also `jcc .L1; jmp .L2; .L1:` into `j!cc .L2`
+void remove_jumps_to_next(X86Func* f, PeepholeStats* stats) {
+  for(int i = 0; i < f->count; ++i) {
+    X86Inst* const inst = &f->insts[i];
+    if(!is_jump(inst->op)) {
+      continue;
+    }
+    if(is_next_label(f, i, inst->label)) {
+      inst->op = X86_NOP;
+      ++stats->hits[JUMP_TO_NEXT];
+      continue;
+    }
+    int const j = next_inst(f, i);
+    if(inst->op != X86_JMP && j >= 0 && f->insts[j].op == X86_JMP && is_next_label(f, j, inst->label)) {
+      inst->op = inst->op == X86_JE ? X86_JNE : X86_JE;
+      inst->label = f->insts[j].label;
+      f->insts[j].op = X86_NOP;
+      ++stats->hits[JUMP_TO_NEXT];
+    }
+  }
+}
+
+void peephole(X86Func* f, PeepholeStats* stats) {
+  forward_stores(f, stats);
+  remove_moves_back(f, stats);
+  fold_immediates(f, stats);
+  remove_dead_moves(f, stats);
+  remove_jumps_to_next(f, stats);
+  compact_X86Func(f);
+}
+
+void print_PeepholeStats(FILE* out, PeepholeStats const* stats) {
+  fprintf(out, "%-20s %10s\n", "peephole", "hits");
+  for(int i = 0; i < NUMBER_OF_PEEPHOLE_PATTERNS; ++i) {
+    fprintf(out, "%-20s %10d\n", PEEPHOLE_PATTERN_NAMES[i], stats->hits[i]);
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef NNA774_KONOHA_PEEPHOLE_H
+#define NNA774_KONOHA_PEEPHOLE_H
+
+#include <stdio.h>
+#include "x86.h"
+
+enum PeepholePattern {
+  STORE_LOAD,     // a load of a slot just stored to(or loaded) reads the register instead
+  IMMEDIATE,      // a register known to hold a constant is read as an immediate
+  REDUNDANT_MOVE, // moves of a value to where it already is
+  DEAD_MOVE,      // moves to registers read by nothing afterwards
+  JUMP_TO_NEXT,   // jumps to the label right after them
+  NUMBER_OF_PEEPHOLE_PATTERNS,
+};
+typedef enum PeepholePattern PeepholePattern;
+
+struct PeepholeStats;
+typedef struct PeepholeStats PeepholeStats;
+
+struct PeepholeStats {
+  int hits[NUMBER_OF_PEEPHOLE_PATTERNS];
+};
+
+// rewrites f in place, counting into stats
+void peephole(X86Func* f, PeepholeStats* stats);
+void print_PeepholeStats(FILE*, PeepholeStats const*);
+
+#endif // NNA774_KONOHA_PEEPHOLE_H
@@ -0,0 +1,106 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+
+size_t const READ_CHUNK = 64 * 1024;
+
+Source* new_Source(char const* top, size_t length, size_t mapped_size) {
+  Source* const src = malloc(sizeof(Source));
+  src->top = top;
+  src->cur = top;
+  src->end = top + length;
+  src->mapped_size = mapped_size;
+  return src;
+}
+
+Source* map_Source(char const* path) {
+  assert(path != NULL);
+  int const fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    warn("can't open %s\n", path);
+    return NULL;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    // not mappable(pipe, device, empty file): read it instead
+    FILE* const fp = fdopen(fd, "r");
+    assert(fp != NULL);
+    Source* const src = read_Source(fp);
+    fclose(fp);
+    return src;
+  }
+  size_t const size = st.st_size;
+  void* const top = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(top == MAP_FAILED) {
+    warn("mmap %s failed\n", path);
+    return NULL;
+  }
+  madvise(top, size, MADV_SEQUENTIAL);
+  return new_Source(top, size, size);
+}
+
+Source* read_Source(FILE* fp) {
+  assert(fp != NULL);
+  size_t capacity = READ_CHUNK;
+  size_t length = 0;
+  char* buf = malloc(capacity);
+  while(true) {
+    if(length == capacity) {
+      capacity *= 2;
+      char* const newbuf = realloc(buf, capacity);
+      if(newbuf == NULL) {
+        warn("read source: realloc failed\n");
+        break;
+      }
+      buf = newbuf;
+    }
+    size_t const n = fread(buf + length, 1, capacity - length, fp);
+    if(n == 0) {
+      break;
+    }
+    length += n;
+  }
+  return new_Source(buf, length, 0);
+}
+
+void close_Source(Source* src) {
+  assert(src != NULL);
+  if(src->mapped_size != 0) {
+    munmap((void*)src->top, src->mapped_size);
+  } else {
+    free((void*)src->top);
+  }
+  free(src);
+}
+
+size_t Source_length(Source const* src) {
+  return src->end - src->top;
+}
+
+int peek(Source const* src) {
+  if(src->cur == src->end) {
+    return EOF;
+  }
+  return (unsigned char)*src->cur;
+}
+
+int next_char(Source* src) {
+  if(src->cur == src->end) {
+    return EOF;
+  }
+  return (unsigned char)*src->cur++;
+}
+
+void skip(Source* src) {
+  char const* p = src->cur;
+  while(p != src->end && isspace((unsigned char)*p)) {
+    ++p;
+  }
+  src->cur = p;
+}
@@ -0,0 +1,29 @@
+#ifndef NNA774_KONOHA_SOURCE_H
+#define NNA774_KONOHA_SOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "utils.h"
+
+struct Source;
+typedef struct Source Source;
+
+// whole input held in memory; the lexer scans it with `cur`.
+// `top` is either mmap'ed (mapped_size != 0) or malloc'ed.
+struct Source {
+  char const* top;
+  char const* cur;
+  char const* end;
+  size_t mapped_size;
+};
+
+Source* map_Source(char const* path);
+Source* read_Source(FILE* fp);
+void close_Source(Source*);
+size_t Source_length(Source const*);
+
+int peek(Source const*);
+int next_char(Source*);
+void skip(Source*);
+
+#endif // NNA774_KONOHA_SOURCE_H
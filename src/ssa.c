@@ -0,0 +1,227 @@
+#include "arena.h"
+#include "cfg.h"
+#include "liveness.h"
+#include "ssa.h"
+
+struct SsaBuilder;
+typedef struct SsaBuilder SsaBuilder;
+
+// Cytron et al.: phis at the iterated dominance frontier of the definitions,
+// then renaming along the dominator tree.
+// vregs of the input are "variables", and renaming makes fresh vregs from 0.
+struct SsaBuilder {
+  IrFunc* func;
+  Cfg const* cfg;
+  Vreg* current; // variable -> its vreg at this point of the walk
+  Vreg* undefined; // variable -> vreg for reading it before any definition
+  // to restore `current` after leaving a dominator subtree
+  Vreg* saved_var;
+  Vreg* saved_val;
+  int saved_count;
+  Vreg next;
+};
+
+void insert_phi(SsaBuilder* s, int block, Vreg var) {
+  Cfg const* const cfg = s->cfg;
+  int const argc = cfg->pred_count[block];
+  IrPhiArg* const args = region_alloc(CODEGEN_REGION, sizeof(IrPhiArg) * (argc + 1));
+  for(int i = 0; i < argc; ++i) {
+    args[i].block = cfg->preds[block][i];
+    args[i].vreg = var;
+  }
+  int const first = append_phi_args(s->func, args, argc);
+  IrInst* const phi = insert_IrInst(s->func, block, 0, IR_PHI);
+  phi->dst = var;
+  phi->phi.args = first;
+  phi->phi.argc = argc;
+}
+
+void place_phis(SsaBuilder* s) {
+  IrFunc* const f = s->func;
+  int const n = f->block_count;
+  int const vars = f->vreg_count;
+  Liveness const* const live = compute_Liveness(f);
+  BitSet** const df = dominance_frontiers(s->cfg);
+
+  // blocks defining each variable(CSR: def_blocks[def_start[v] ...])
+  int* const def_start = region_alloc(CODEGEN_REGION, sizeof(int) * (vars + 1));
+  for(int v = 0; v <= vars; ++v) {
+    def_start[v] = 0;
+  }
+  for(int i = 0; i < n; ++i) {
+    for(int j = 0; j < f->blocks[i].count; ++j) {
+      Vreg const dst = f->blocks[i].insts[j].dst;
+      if(dst != NO_VREG) {
+        ++def_start[dst + 1];
+      }
+    }
+  }
+  for(int v = 0; v < vars; ++v) {
+    def_start[v + 1] += def_start[v];
+  }
+  int* const def_blocks = region_alloc(CODEGEN_REGION, sizeof(int) * (def_start[vars] + 1));
+  int* const filled = region_alloc(CODEGEN_REGION, sizeof(int) * (vars + 1));
+  for(int v = 0; v < vars; ++v) {
+    filled[v] = def_start[v];
+  }
+  for(int i = 0; i < n; ++i) {
+    for(int j = 0; j < f->blocks[i].count; ++j) {
+      Vreg const dst = f->blocks[i].insts[j].dst;
+      if(dst != NO_VREG) {
+        def_blocks[filled[dst]++] = i;
+      }
+    }
+  }
+
+  // stamps are v + 1, so nothing needs clearing between variables
+  int* const has_phi = region_alloc(CODEGEN_REGION, sizeof(int) * n);
+  int* const queued = region_alloc(CODEGEN_REGION, sizeof(int) * n);
+  int* const worklist = region_alloc(CODEGEN_REGION, sizeof(int) * n);
+  for(int i = 0; i < n; ++i) {
+    has_phi[i] = 0;
+    queued[i] = 0;
+  }
+  for(int v = 0; v < vars; ++v) {
+    int count = 0;
+    for(int k = def_start[v]; k < def_start[v + 1]; ++k) {
+      int const b = def_blocks[k];
+      if(queued[b] != v + 1) {
+        queued[b] = v + 1;
+        worklist[count++] = b;
+      }
+    }
+    while(count != 0) {
+      int const b = worklist[--count];
+      for(int d = BitSet_next(df[b], 0); d >= 0; d = BitSet_next(df[b], d + 1)) {
+        if(has_phi[d] == v + 1 || !BitSet_has(live->live_in[d], v)) {
+          continue;
+        }
+        has_phi[d] = v + 1;
+        insert_phi(s, d, v);
+        if(queued[d] != v + 1) {
+          queued[d] = v + 1;
+          worklist[count++] = d;
+        }
+      }
+    }
+  }
+}
+
+Vreg current_name(SsaBuilder* s, Vreg var) {
+  if(s->current[var] != NO_VREG) {
+    return s->current[var];
+  }
+  if(s->undefined[var] == NO_VREG) {
+    s->undefined[var] = s->next++;
+  }
+  return s->undefined[var];
+}
+
+void define_name(SsaBuilder* s, IrInst* inst) {
+  Vreg const var = inst->dst;
+  s->saved_var[s->saved_count] = var;
+  s->saved_val[s->saved_count] = s->current[var];
+  ++s->saved_count;
+  s->current[var] = s->next++;
+  inst->dst = s->current[var];
+}
+
+void rename_block(SsaBuilder* s, int block) {
+  IrFunc* const f = s->func;
+  int const saved = s->saved_count;
+  IrBlock* const b = &f->blocks[block];
+  for(int i = 0; i < b->count; ++i) {
+    IrInst* const inst = &b->insts[i];
+    if(inst->op != IR_PHI) {
+      for(int k = 0; k < IrInst_use_count(inst); ++k) {
+        Vreg* const use = IrInst_use_ref(f, inst, k);
+        *use = current_name(s, *use);
+      }
+    }
+    if(inst->dst != NO_VREG) {
+      define_name(s, inst);
+    }
+  }
+
+  int succ[2];
+  int succ_count = IrBlock_successors(b, succ);
+  if(succ_count == 2 && succ[0] == succ[1]) {
+    succ_count = 1;
+  }
+  for(int i = 0; i < succ_count; ++i) {
+    IrBlock const* const sb = &f->blocks[succ[i]];
+    for(int j = 0; j < sb->count && sb->insts[j].op == IR_PHI; ++j) {
+      IrInst const* const phi = &sb->insts[j];
+      for(int k = 0; k < phi->phi.argc; ++k) {
+        IrPhiArg* const arg = &f->phi_args[phi->phi.args + k];
+        if(arg->block == block) {
+          arg->vreg = current_name(s, arg->vreg);
+        }
+      }
+    }
+  }
+
+  for(int i = 0; i < s->cfg->child_count[block]; ++i) {
+    rename_block(s, s->cfg->children[block][i]);
+  }
+
+  while(s->saved_count != saved) {
+    --s->saved_count;
+    s->current[s->saved_var[s->saved_count]] = s->saved_val[s->saved_count];
+  }
+}
+
+void build_ssa(IrFunc* f) {
+  prune_unreachable_blocks(f);
+  SsaBuilder builder;
+  SsaBuilder* const s = &builder;
+  s->func = f;
+  s->cfg = compute_Cfg(f);
+  place_phis(s);
+
+  int const vars = f->vreg_count;
+  int const insts = IrFunc_inst_count(f);
+  s->current = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (vars + 1));
+  s->undefined = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (vars + 1));
+  for(int v = 0; v < vars; ++v) {
+    s->current[v] = NO_VREG;
+    s->undefined[v] = NO_VREG;
+  }
+  s->saved_var = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (insts + 1));
+  s->saved_val = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (insts + 1));
+  s->saved_count = 0;
+  s->next = 0;
+  rename_block(s, 0);
+
+  // reading an uninitialized variable gives 0
+  for(int v = 0; v < vars; ++v) {
+    if(s->undefined[v] != NO_VREG) {
+      IrInst* const inst = insert_IrInst(f, 0, 0, IR_CONST);
+      inst->dst = s->undefined[v];
+      inst->imm = 0;
+    }
+  }
+  f->vreg_count = s->next;
+}
+
+// each phi gets a fresh vreg, copied at the end of every predecessor and read at the phi.
+// the copies write nothing else, so critical edges and swapped phis need no care
+void leave_ssa(IrFunc* f) {
+  for(int i = 0; i < f->block_count; ++i) {
+    for(int j = 0; j < f->blocks[i].count && f->blocks[i].insts[j].op == IR_PHI; ++j) {
+      IrInst const phi = f->blocks[i].insts[j];
+      Vreg const copy = new_Vreg(f);
+      for(int k = 0; k < phi.phi.argc; ++k) {
+        IrPhiArg const arg = f->phi_args[phi.phi.args + k];
+        IrBlock const* const pred = &f->blocks[arg.block];
+        IrInst* const mov = insert_IrInst(f, arg.block, pred->count - 1, IR_MOV);
+        mov->dst = copy;
+        mov->a = arg.vreg;
+      }
+      // the block may have grown by its own copies(a loop to itself)
+      IrInst* const inst = &f->blocks[i].insts[j];
+      inst->op = IR_MOV;
+      inst->a = copy;
+    }
+  }
+}
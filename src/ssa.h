@@ -0,0 +1,12 @@
+#ifndef NNA774_KONOHA_SSA_H
+#define NNA774_KONOHA_SSA_H
+
+#include "ir.h"
+
+// every vreg gets exactly one definition, with phis where control flow joins.
+// pruned: phis only where the value is live. unreachable blocks are dropped
+void build_ssa(IrFunc*);
+// phis -> movs, so the backend never sees them
+void leave_ssa(IrFunc*);
+
+#endif // NNA774_KONOHA_SSA_H
@@ -0,0 +1,170 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "arena.h"
+#include "symbol.h"
+
+// open addressing(linear probing) over unique names.
+// names themselves are packed into large chunks taken from AST_REGION.
+
+struct SymbolEntry {
+  Symbol name;
+  uint32_t hash;
+  uint32_t length;
+};
+
+size_t const INITIAL_SYMBOL_TABLE_SIZE = 1024; // must be power of 2
+size_t const NAME_CHUNK_SIZE = 64 * 1024;
+
+struct SymbolEntry* symbol_table = NULL;
+size_t symbol_table_size = 0;
+size_t symbol_table_used = 0;
+
+char* name_chunk = NULL;
+size_t name_chunk_rest = 0;
+
+uint32_t hash_name(char const* str, size_t length) {
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for(size_t i = 0; i < length; ++i) {
+    h ^= (unsigned char)str[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+char* store_name(char const* str, size_t length) {
+  if(length + 1 > name_chunk_rest) {
+    size_t const size = length + 1 > NAME_CHUNK_SIZE ? length + 1 : NAME_CHUNK_SIZE;
+    name_chunk = region_alloc(AST_REGION, size);
+    name_chunk_rest = size;
+  }
+  char* const name = name_chunk;
+  memcpy(name, str, length);
+  name[length] = '\0';
+  name_chunk += length + 1;
+  name_chunk_rest -= length + 1;
+  return name;
+}
+
+void grow_table() {
+  size_t const old_size = symbol_table_size;
+  struct SymbolEntry* const old = symbol_table;
+  symbol_table_size = old_size == 0 ? INITIAL_SYMBOL_TABLE_SIZE : old_size * 2;
+  symbol_table = calloc(symbol_table_size, sizeof(struct SymbolEntry));
+  for(size_t i = 0; i < old_size; ++i) {
+    if(old[i].name == NULL) { continue; }
+    size_t j = old[i].hash & (symbol_table_size - 1);
+    while(symbol_table[j].name != NULL) {
+      j = (j + 1) & (symbol_table_size - 1);
+    }
+    symbol_table[j] = old[i];
+  }
+  free(old);
+}
+
+Symbol intern(char const* str, size_t length) {
+  if((symbol_table_used + 1) * 2 > symbol_table_size) {
+    grow_table();
+  }
+  uint32_t const h = hash_name(str, length);
+  size_t i = h & (symbol_table_size - 1);
+  while(symbol_table[i].name != NULL) {
+    if(symbol_table[i].hash == h
+       && symbol_table[i].length == length
+       && !memcmp(symbol_table[i].name, str, length)) {
+      return symbol_table[i].name;
+    }
+    i = (i + 1) & (symbol_table_size - 1);
+  }
+  symbol_table[i].name = store_name(str, length);
+  symbol_table[i].hash = h;
+  symbol_table[i].length = length;
+  ++symbol_table_used;
+  return symbol_table[i].name;
+}
+
+Symbol intern_cstr(char const* str) {
+  return intern(str, strlen(str));
+}
+
+struct SymbolMapEntry {
+  Symbol key;
+  void* value;
+};
+
+struct SymbolMap {
+  struct SymbolMapEntry* entries;
+  size_t size; // power of 2, or 0 before first insert
+  size_t used;
+};
+
+size_t const INITIAL_SYMBOL_MAP_SIZE = 8;
+
+// the slot of sym in a map of size(a power of 2): the top log2(size) bits of
+// the address times 2^64/phi(Fibonacci hashing). the low bits of the product
+// would depend only on the low bits of the address, and packed names are
+// often just a few bytes apart
+size_t symbol_slot(Symbol sym, size_t size) {
+  assert(size >= 2);
+  return (size_t)(((uint64_t)(uintptr_t)sym * 11400714819323198485ull) >> (64 - __builtin_ctzll(size)));
+}
+
+SymbolMap* new_SymbolMap() {
+  SymbolMap* const m = region_alloc(AST_REGION, sizeof(SymbolMap));
+  m->entries = NULL;
+  m->size = 0;
+  m->used = 0;
+  return m;
+}
+
+void* SymbolMap_find(SymbolMap const* m, Symbol key) {
+  assert(key != NULL);
+  if(m->used == 0) {
+    return NULL;
+  }
+  size_t const mask = m->size - 1;
+  for(size_t i = symbol_slot(key, m->size); m->entries[i].key != NULL; i = (i + 1) & mask) {
+    if(m->entries[i].key == key) {
+      return m->entries[i].value;
+    }
+  }
+  return NULL;
+}
+
+void grow_SymbolMap(SymbolMap* m) {
+  size_t const old_size = m->size;
+  struct SymbolMapEntry* const old = m->entries;
+  m->size = old_size == 0 ? INITIAL_SYMBOL_MAP_SIZE : old_size * 2;
+  m->entries = calloc(m->size, sizeof(struct SymbolMapEntry));
+  size_t const mask = m->size - 1;
+  for(size_t i = 0; i < old_size; ++i) {
+    if(old[i].key == NULL) { continue; }
+    size_t j = symbol_slot(old[i].key, m->size);
+    while(m->entries[j].key != NULL) {
+      j = (j + 1) & mask;
+    }
+    m->entries[j] = old[i];
+  }
+  free(old);
+}
+
+// overwrites the value if `key` is already in `m`
+void SymbolMap_insert(SymbolMap* m, Symbol key, void* value) {
+  assert(key != NULL);
+  if((m->used + 1) * 2 > m->size) {
+    grow_SymbolMap(m);
+  }
+  size_t const mask = m->size - 1;
+  size_t i = symbol_slot(key, m->size);
+  while(m->entries[i].key != NULL) {
+    if(m->entries[i].key == key) {
+      m->entries[i].value = value;
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  m->entries[i].key = key;
+  m->entries[i].value = value;
+  ++m->used;
+}
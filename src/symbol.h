@@ -0,0 +1,22 @@
+#ifndef NNA774_KONOHA_SYMBOL_H
+#define NNA774_KONOHA_SYMBOL_H
+
+#include <stddef.h>
+#include "utils.h"
+
+// interned NUL-terminated name.
+// two Symbols are the same name iff they are the same pointer.
+typedef char const* Symbol;
+
+Symbol intern(char const* str, size_t length);
+Symbol intern_cstr(char const* str);
+
+// Symbol -> value map(open addressing, keyed by the Symbol pointer)
+struct SymbolMap;
+typedef struct SymbolMap SymbolMap;
+
+SymbolMap* new_SymbolMap();
+void* SymbolMap_find(SymbolMap const*, Symbol);
+void SymbolMap_insert(SymbolMap*, Symbol, void*);
+
+#endif // NNA774_KONOHA_SYMBOL_H
@@ -0,0 +1,74 @@
+#include "arena.h"
+#include "tail.h"
+
+bool is_self_tail_call(IrFunc const* f, IrBlock const* b) {
+  if(b->count < 2) {
+    return false;
+  }
+  IrInst const* const call = &b->insts[b->count - 2];
+  IrInst const* const ret = &b->insts[b->count - 1];
+  return call->op == IR_CALL &&
+    call->name == f->name &&
+    call->call.argc == f->argc &&
+    ret->op == IR_RET &&
+    (ret->a == NO_VREG || ret->a == call->dst);
+}
+
+void eliminate_tail_recursion(IrFunc* f) {
+  bool found = false;
+  for(int i = 0; i < f->block_count; ++i) {
+    found = found || is_self_tail_call(f, &f->blocks[i]);
+  }
+  if(!found) {
+    return;
+  }
+  // the old entry becomes the loop head, and a new one takes the parameters
+  int const entry = new_IrBlock(f);
+  Vreg* const params = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (f->argc + 1));
+  for(int i = 0; i < f->argc; ++i) {
+    params[i] = NO_VREG;
+  }
+  IrBlock* const head = &f->blocks[0];
+  for(int j = 0; j < head->count; ++j) {
+    IrInst* const inst = &head->insts[j];
+    if(inst->op == IR_PARAM) {
+      params[inst->imm] = inst->dst;
+      *append_IrInst(f, entry, IR_NOP) = *inst;
+      inst->op = IR_NOP;
+      inst->dst = NO_VREG;
+    }
+  }
+  compact_IrBlock(head);
+  append_IrInst(f, entry, IR_JMP)->target[0] = 0;
+
+  Vreg* const temps = region_alloc(CODEGEN_REGION, sizeof(Vreg) * (f->argc + 1));
+  for(int i = 0; i < f->block_count; ++i) {
+    IrBlock* const b = &f->blocks[i];
+    if(i == entry || !is_self_tail_call(f, b)) {
+      continue;
+    }
+    IrInst const call = b->insts[b->count - 2];
+    b->count -= 2;
+    // arguments may read parameters, so they're all copied before any is overwritten
+    for(int k = 0; k < f->argc; ++k) {
+      IrInst* const mov = append_IrInst(f, i, IR_MOV);
+      mov->dst = temps[k] = new_Vreg(f);
+      mov->a = IrInst_use(f, &call, k);
+    }
+    for(int k = 0; k < f->argc; ++k) {
+      if(params[k] != NO_VREG) {
+        IrInst* const mov = append_IrInst(f, i, IR_MOV);
+        mov->dst = params[k];
+        mov->a = temps[k];
+      }
+    }
+    append_IrInst(f, i, IR_JMP)->target[0] = 0;
+  }
+
+  int* const order = region_alloc(CODEGEN_REGION, sizeof(int) * f->block_count);
+  order[0] = entry;
+  for(int i = 0; i < entry; ++i) {
+    order[i + 1] = i;
+  }
+  reorder_IrBlocks(f, order, f->block_count);
+}
@@ -0,0 +1,11 @@
+#ifndef NNA774_KONOHA_TAIL_H
+#define NNA774_KONOHA_TAIL_H
+
+#include "ir.h"
+
+// `%r = call f(...); ret %r` inside f itself becomes moves to f's parameters
+// and a jump back to the top, so self recursion in tail position is a loop.
+// works on IR out of SSA
+void eliminate_tail_recursion(IrFunc*);
+
+#endif // NNA774_KONOHA_TAIL_H
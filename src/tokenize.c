@@ -1,6 +1,8 @@
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "tokenize.h"
 #include "utils.h"
 
@@ -27,115 +29,143 @@ bool is_operator_char(char c) {
   return false;
 }
 
-bool is_keyword(String str_) {
-  char const* const str = c_str(str_);
-  char const* const keywords[] = {
-    "auto",
-    "break",
-    "case",
-    "char",
-    "const",
-    "continue",
-    "default",
-    "do",
-    "double",
-    "else",
-    "enum",
-    "extern",
-    "float",
-    "for",
-    "goto",
-    "if",
-    "int",
-    "long",
-    "register",
-    "return",
-    "short",
-    "signed",
-    "sizeof",
-    "static",
-    "struct",
-    "switch",
-    "typedef",
-    "union",
-    "unsigned",
-    "void",
-    "volatile",
-    "while",
-  };
-  for(int i = 0; i < (int)(sizeof(keywords) / sizeof(*keywords)); ++i) {
-    if(!strcmp(str, keywords[i])) {
-      return true;
+// compares the whole identifier since the switch below only looked at its length and head
+#define KEYWORD(str, kw, kind) \
+  (!memcmp((str), (kw), sizeof(kw) - 1) ? (kind) : KW_NONE)
+
+// length + first char switch; at most one memcmp per identifier
+KeywordKind to_KeywordKind(char const* s, int length) {
+  switch(length) {
+  case 2:
+    switch(s[0]) {
+    case 'd': return KEYWORD(s, "do", KW_DO);
+    case 'i': return KEYWORD(s, "if", KW_IF);
+    }
+    break;
+  case 3:
+    switch(s[0]) {
+    case 'f': return KEYWORD(s, "for", KW_FOR);
+    case 'i': return KEYWORD(s, "int", KW_INT);
+    }
+    break;
+  case 4:
+    switch(s[0]) {
+    case 'a': return KEYWORD(s, "auto", KW_AUTO);
+    case 'c': return s[1] == 'a' ? KEYWORD(s, "case", KW_CASE) : KEYWORD(s, "char", KW_CHAR);
+    case 'e': return s[1] == 'l' ? KEYWORD(s, "else", KW_ELSE) : KEYWORD(s, "enum", KW_ENUM);
+    case 'g': return KEYWORD(s, "goto", KW_GOTO);
+    case 'l': return KEYWORD(s, "long", KW_LONG);
+    case 'v': return KEYWORD(s, "void", KW_VOID);
+    }
+    break;
+  case 5:
+    switch(s[0]) {
+    case 'b': return KEYWORD(s, "break", KW_BREAK);
+    case 'c': return KEYWORD(s, "const", KW_CONST);
+    case 'f': return KEYWORD(s, "float", KW_FLOAT);
+    case 's': return KEYWORD(s, "short", KW_SHORT);
+    case 'u': return KEYWORD(s, "union", KW_UNION);
+    case 'w': return KEYWORD(s, "while", KW_WHILE);
+    }
+    break;
+  case 6:
+    switch(s[0]) {
+    case 'd': return KEYWORD(s, "double", KW_DOUBLE);
+    case 'e': return KEYWORD(s, "extern", KW_EXTERN);
+    case 'r': return KEYWORD(s, "return", KW_RETURN);
+    case 's':
+      switch(s[2]) {
+      case 'g': return KEYWORD(s, "signed", KW_SIGNED);
+      case 'z': return KEYWORD(s, "sizeof", KW_SIZEOF);
+      case 'a': return KEYWORD(s, "static", KW_STATIC);
+      case 'r': return KEYWORD(s, "struct", KW_STRUCT);
+      case 'i': return KEYWORD(s, "switch", KW_SWITCH);
+      }
+      break;
+    }
+    break;
+  case 7:
+    switch(s[0]) {
+    case 'd': return KEYWORD(s, "default", KW_DEFAULT);
+    case 't': return KEYWORD(s, "typedef", KW_TYPEDEF);
     }
+    break;
+  case 8:
+    switch(s[0]) {
+    case 'c': return KEYWORD(s, "continue", KW_CONTINUE);
+    case 'r': return KEYWORD(s, "register", KW_REGISTER);
+    case 'u': return KEYWORD(s, "unsigned", KW_UNSIGNED);
+    case 'v': return KEYWORD(s, "volatile", KW_VOLATILE);
+    }
+    break;
   }
-  return false;
+  return KW_NONE;
 }
 
-Token* new_Token(String str, TokenType ty) {
-  Token* t = malloc(sizeof(Token));
-  t->string = str;
-  t->type = ty;
-  init_Token_hook(t);
-  return t;
-}
+#undef KEYWORD
 
-Token* copy_Token(Token _t) {
-  Token* t = malloc(sizeof(Token));
-  t->string = _t.string;
-  t->type = _t.type;
-  init_Token_hook(t);
+Token make_Token(char const* top, char const* end, TokenType ty) {
+  Token t;
+  t.type = ty;
+  t.keyword = KW_NONE;
+  t.length = end - top;
+  t.sym = NULL;
+  t.top = top;
   return t;
 }
 
-Token* read_identifier(FILE* fp) {
-  int c;
-  String str = new_String();
-  while(c = getc(fp), is_identifier_char(c)) {
-    append_char(str, c);
+Token read_identifier(Source* src) {
+  char const* const begin = src->cur;
+  char const* p = begin;
+  while(p != src->end && is_identifier_char(*p)) {
+    ++p;
   }
-  ungetc(c, fp);
-  if(is_keyword(str)) {
-    return new_Token(str, KEYWORD_T);
-  }
-  return new_Token(str, IDENTIFIER_T);
+  src->cur = p;
+  KeywordKind const kw = to_KeywordKind(begin, p - begin);
+  Token t = make_Token(begin, p, kw != KW_NONE ? KEYWORD_T : IDENTIFIER_T);
+  t.keyword = kw;
+  t.sym = intern(begin, p - begin);
+  return t;
 }
 
-Token* read_integer(FILE* fp) {
-  int c;
-  String str = new_String();
-  while(c = getc(fp), isdigit(c)) {
-    append_char(str, c);
+Token read_integer(Source* src) {
+  char const* const begin = src->cur;
+  char const* p = begin;
+  while(p != src->end && isdigit((unsigned char)*p)) {
+    ++p;
   }
-  ungetc(c, fp);
-  return new_Token(str, INTEGER_LITERAL_T);
+  src->cur = p;
+  return make_Token(begin, p, INTEGER_LITERAL_T);
 }
 
-Token* read_character(FILE* fp) {
-  getc(fp);
+Token read_character(Source* src) {
+  next_char(src);
+  char const* const begin = src->cur;
   int c;
-  String str = new_String();
-  while(c = getc(fp), c != '\'') {
+  while(c = peek(src), c != '\'' && c != EOF) {
     if(c == '\\') {
       warn("unimpled yet!\n");
-    } else {
-      append_char(str, c);
     }
+    next_char(src);
   }
-  return new_Token(str, CHARACTER_LITERAL_T);
+  Token const t = make_Token(begin, src->cur, CHARACTER_LITERAL_T);
+  next_char(src);
+  return t;
 }
 
-Token* read_paren_impl(FILE* fp, bool open) {
-  int c = getc(fp);
+Token read_paren_impl(Source* src, bool open) {
+  char const* const begin = src->cur;
+  int c = next_char(src);
   assert(is_open_paren(c) || is_close_paren(c));
-  return new_Token(from_char(c), open ? OPEN_PAREN_T : CLOSE_PAREN_T);
+  return make_Token(begin, src->cur, open ? OPEN_PAREN_T : CLOSE_PAREN_T);
 }
 
-Token* read_open_paren(FILE* fp) {
-  return read_paren_impl(fp, true);
+Token read_open_paren(Source* src) {
+  return read_paren_impl(src, true);
 }
 
-Token* read_close_paren(FILE* fp) {
-  return read_paren_impl(fp, false);
+Token read_close_paren(Source* src) {
+  return read_paren_impl(src, false);
 }
 
 bool is_op(TokenType t) {
@@ -155,134 +185,175 @@ bool is_op(TokenType t) {
   return false;
 }
 
-TokenType to_TokenType(char const* str) {
-  if(!strcmp(str, "+")) {
-    return OP_PLUS_T;
-  }
-  if(!strcmp(str, "-")) {
-    return OP_MINUS_T;
-  }
-  if(!strcmp(str, "*")) {
+TokenType to_TokenType(char c, bool twice) {
+  switch(c) {
+  case '+':
+    return twice ? OP_INC_T : OP_PLUS_T;
+  case '-':
+    return twice ? OP_DEC_T : OP_MINUS_T;
+  case '*':
     return OP_MULTI_T;
-  }
-  if(!strcmp(str, "/")) {
+  case '/':
     return OP_DIV_T;
+  case '=':
+    return twice ? OP_EQUAL_T : OP_ASSIGN_T;
   }
-  if(!strcmp(str, "++")) {
-    return OP_INC_T;
-  }
-  if(!strcmp(str, "--")) {
-    return OP_DEC_T;
-  }
-  if(!strcmp(str, "==")) {
-    return OP_EQUAL_T;
-  }
-  if(!strcmp(str, "=")) {
-    return OP_ASSIGN_T;
-  }
-
-  warn("unknown token(%s)\n", str);
+  warn("unknown token(%c)\n", c);
   return UNKNOWN_T;
 }
 
-Token* read_operator_and_comment(FILE* fp) {
-  int const c = getc(fp);
+Token read_operator_and_comment(Source* src) {
+  char const* const begin = src->cur;
+  int const c = next_char(src);
   if(c == '/') {
-    int const next = peek(fp);
+    int const next = peek(src);
     if(next == '/') {
       //
-      int c;
-      while(c = getc(fp), c != '\n');
-      return new_Token(from_char('/'), COMMENT_T);
+      char const* const nl = memchr(src->cur, '\n', src->end - src->cur);
+      src->cur = nl != NULL ? nl + 1 : src->end;
+      return make_Token(begin, begin + 1, COMMENT_T);
     } else if(next == '*') {
       /* */
-      int c;
-      while(true) {
-        while(c = getc(fp), c != '*');
-        if(c = getc(fp), c == '/') {
-          break;
-        }
+      char const* p = src->cur + 1;
+      while(p + 1 < src->end && !(p[0] == '*' && p[1] == '/')) {
+        ++p;
       }
-      return new_Token(from_char('*'), COMMENT_T);
+      src->cur = p + 1 < src->end ? p + 2 : src->end;
+      return make_Token(begin, begin + 1, COMMENT_T);
     }
   }
-  char* const twices[] = { "==", "++", "--", };
-  for(int i = 0; i < (int)(sizeof(twices) / sizeof(*twices)); ++i) {
-    if(c == twices[i][0]) {
-      int const next = peek(fp);
-      if(next == twices[i][0]) {
-        getc(fp);
-        return new_Token(to_String(2, twices[i]), to_TokenType(twices[i]));
-      }
-    }
+  bool const twice = (c == '=' || c == '+' || c == '-') && peek(src) == c;
+  if(twice) {
+    next_char(src);
   }
-  String s = from_char(c);
-  return new_Token(s, to_TokenType(c_str(s)));
+  return make_Token(begin, src->cur, to_TokenType(c, twice));
 }
 
-Token* read_token(FILE* fp) {
-  int const c = peek(fp);
-  Token* t = NULL;
+Token read_token(Source* src) {
+  int const c = peek(src);
+  Token t = make_Token(src->cur, src->cur, UNKNOWN_T);
   if(isdigit(c)) {
-    t = read_integer(fp);
+    t = read_integer(src);
   } else if(is_identifier_char(c)){
-    t = read_identifier(fp);
+    t = read_identifier(src);
   } else if(is_open_paren(c)) {
-    t = read_open_paren(fp);
+    t = read_open_paren(src);
   } else if(is_close_paren(c)) {
-    t = read_close_paren(fp);
+    t = read_close_paren(src);
   } else if(is_operator_char(c)) {
-    t = read_operator_and_comment(fp);
+    t = read_operator_and_comment(src);
   } else if(c == ',') {
-    getc(fp);
-    t = new_Token(from_char(','), COMMA_T);
+    t = make_Token(src->cur, src->cur + 1, COMMA_T);
+    next_char(src);
   } else if(c == ';') {
-    getc(fp);
-    t = new_Token(from_char(';'), SEMICOLON_T);
+    t = make_Token(src->cur, src->cur + 1, SEMICOLON_T);
+    next_char(src);
   } else if(c == '\'') {
-    t = read_character(fp);
+    t = read_character(src);
   } else {
     printf("got %s\n", show_char(c));
   }
-  assert(t != NULL);
+  assert(t.type != UNKNOWN_T);
   return t;
 }
 
-INTRUSIVE_LIST_OF(Token) tokenize(FILE* fp) {
-  INTRUSIVE_LIST_OF(Token) tokens = new_list_of_Token();
-  int c;
-  skip(fp);
-  while(c = peek(fp), c != EOF) {
-    Token* t = read_token(fp);
-    assert(t != NULL);
-    if(t->type != COMMENT_T) {
-      list_of_Token_append(tokens, t);
+void append_Token(Tokens ts, Token t) {
+  if(ts->count == ts->capacity) {
+    // the old array stays in TOKEN_REGION until it's released
+    int const capacity = ts->capacity * 2;
+    Token* const tokens = region_alloc(TOKEN_REGION, sizeof(Token) * capacity);
+    memcpy(tokens, ts->tokens, sizeof(Token) * ts->count);
+    ts->tokens = tokens;
+    ts->capacity = capacity;
+  }
+  ts->tokens[ts->count++] = t;
+}
+
+Tokens tokenize(Source* src) {
+  Tokens ts = region_alloc(TOKEN_REGION, sizeof(TokenStream));
+  // rough guess: one token per 4 bytes
+  ts->capacity = Source_length(src) / 4 + 16;
+  ts->tokens = region_alloc(TOKEN_REGION, sizeof(Token) * ts->capacity);
+  ts->count = 0;
+  ts->pos = 0;
+  skip(src);
+  while(src->cur != src->end) {
+    Token const t = read_token(src);
+    if(t.type != COMMENT_T) {
+      append_Token(ts, t);
     }
-    skip(fp);
+    skip(src);
   }
-  Token* eof_t = new_Token(new_String(), EOF_T);
-  list_of_Token_append(tokens, eof_t);
-  return tokens;
+  append_Token(ts, make_Token(src->end, src->end, EOF_T));
+  return ts;
 }
 
-Token pop_Token(Tokens ts) {
-  return *list_of_Token_pop(ts);
+int Tokens_length(Tokens ts) {
+  return ts->count;
+}
+
+int Tokens_rest(Tokens ts) {
+  return ts->count - ts->pos;
+}
+
+int Tokens_pos(Tokens ts) {
+  return ts->pos;
 }
 
-void push_Token(Tokens ts, Token t) {
-  list_of_Token_push(ts, copy_Token(t));
+void rewind_Tokens(Tokens ts, int pos) {
+  assert(0 <= pos && pos <= ts->pos);
+  ts->pos = pos;
+}
+
+// reading past the end keeps returning EOF_T
+Token peek_nth_Token(Tokens ts, int n) {
+  int const i = ts->pos + n;
+  return ts->tokens[i < ts->count ? i : ts->count - 1];
 }
 
 Token peek_Token(Tokens ts) {
-  return *(ts->head);
+  return peek_nth_Token(ts, 0);
+}
+
+void advance_Token(Tokens ts) {
+  if(ts->pos < ts->count) {
+    ++ts->pos;
+  }
+}
+
+Token pop_Token(Tokens ts) {
+  Token const t = peek_Token(ts);
+  advance_Token(ts);
+  return t;
+}
+
+void unget_Token(Tokens ts) {
+  assert(ts->pos > 0);
+  --ts->pos;
+}
+
+char Token_head(Token const t) {
+  return t.length != 0 ? t.top[0] : '\0';
+}
+
+bool Token_equals(Token const t, char const* str) {
+  return !strncmp(t.top, str, t.length) && str[t.length] == '\0';
+}
+
+char const* Token_c_str(Token const t) {
+  char* const buf = region_alloc(TOKEN_REGION, t.length + 1);
+  memcpy(buf, t.top, t.length);
+  buf[t.length] = '\0';
+  return buf;
 }
 
 void print_Token(Token const* t) {
-  printf("%s: %s\n", show_TokenType(t->type), c_str(t->string));
+  printf("%s: %.*s\n", show_TokenType(t->type), t->length, t->top);
 }
 
-void print_Tokens(INTRUSIVE_LIST_OF(Token) ts) {
-  FOREACH(Token, ts, t) {
-    print_Token(t);
+// prints tokens which are not consumed yet
+void print_Tokens(Tokens ts) {
+  for(int i = ts->pos; i < ts->count; ++i) {
+    print_Token(&ts->tokens[i]);
   }
 }
@@ -1,7 +1,8 @@
 #ifndef NNA774_KONOHA_TOKENIZE_H
 #define NNA774_KONOHA_TOKENIZE_H
 
-#include "string.h"
+#include "source.h"
+#include "symbol.h"
 #include "list.h"
 #include "enum.h"
 
@@ -29,26 +30,85 @@ ENUM_WITH_SHOW(
   UNKNOWN_T,
 )
 
+ENUM_WITH_SHOW(
+  KeywordKind,
+  KW_NONE,
+  KW_AUTO,
+  KW_BREAK,
+  KW_CASE,
+  KW_CHAR,
+  KW_CONST,
+  KW_CONTINUE,
+  KW_DEFAULT,
+  KW_DO,
+  KW_DOUBLE,
+  KW_ELSE,
+  KW_ENUM,
+  KW_EXTERN,
+  KW_FLOAT,
+  KW_FOR,
+  KW_GOTO,
+  KW_IF,
+  KW_INT,
+  KW_LONG,
+  KW_REGISTER,
+  KW_RETURN,
+  KW_SHORT,
+  KW_SIGNED,
+  KW_SIZEOF,
+  KW_STATIC,
+  KW_STRUCT,
+  KW_SWITCH,
+  KW_TYPEDEF,
+  KW_UNION,
+  KW_UNSIGNED,
+  KW_VOID,
+  KW_VOLATILE,
+  KW_WHILE,
+)
+
 struct Token;
 typedef struct Token Token;
 
+// view into the Source buffer(not NUL-terminated)
 struct Token {
-  String string;
   TokenType type;
-  INTRUSIVE_LIST_HOOK(Token);
+  KeywordKind keyword; // KW_NONE unless type is KEYWORD_T
+  int length;
+  Symbol sym; // interned text of IDENTIFIER_T and KEYWORD_T, otherwise NULL
+  char const* top;
 };
 
-DEFINE_INTRUSIVE_LIST(Token);
+struct TokenStream;
+typedef struct TokenStream TokenStream;
 
-typedef INTRUSIVE_LIST_OF(Token) Tokens;
+// all tokens in one array, the last one is EOF_T.
+// the parser reads it through the `pos` cursor.
+struct TokenStream {
+  Token* tokens;
+  int count;
+  int capacity;
+  int pos;
+};
 
-Tokens tokenize(FILE*);
-Token pop_Token(Tokens);
-void push_Token(Tokens, Token);
+typedef TokenStream* Tokens;
+
+Tokens tokenize(Source*);
+int Tokens_length(Tokens);
+int Tokens_rest(Tokens);
+int Tokens_pos(Tokens);
+void rewind_Tokens(Tokens, int pos);
 Token peek_Token(Tokens);
+Token peek_nth_Token(Tokens, int);
+void advance_Token(Tokens);
+Token pop_Token(Tokens);
+void unget_Token(Tokens);
 void print_Token(Token const*);
-void print_Tokens(INTRUSIVE_LIST_OF(Token));
-TokenType to_TokenType(char const* str);
+void print_Tokens(Tokens);
+char Token_head(Token const);
+bool Token_equals(Token const, char const*);
+char const* Token_c_str(Token const);
 bool is_op(TokenType t);
+KeywordKind to_KeywordKind(char const* str, int length);
 
 #endif // NNA774_KONOHA_TOKENIZE_H
@@ -1,3 +1,7 @@
 #define ENUM_SHOW_DEFINE
+#include "arena.h"
 #include "ast.h"
+#include "bytecode.h"
+#include "ir.h"
 #include "tokenize.h"
+#include "x86.h"
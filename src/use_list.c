@@ -6,5 +6,4 @@ USE_INTRUSIVE_LIST(Type);
 USE_INTRUSIVE_LIST(Var);
 USE_INTRUSIVE_LIST(Statement);
 USE_INTRUSIVE_LIST(String);
-USE_INTRUSIVE_LIST(Token);
 USE_INTRUSIVE_LIST(Ast);
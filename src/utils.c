@@ -4,25 +4,6 @@
 #include <stdarg.h>
 #include "utils.h"
 
-int peek(FILE* fp) {
-  int const c = getc(fp);
-  if(c == EOF) {
-    return EOF;
-  }
-  ungetc(c, fp);
-  return c;
-}
-
-void skip(FILE* fp) {
-  int c;
-  while(c = getc(fp), c != EOF) {
-    if(!isspace(c)) {
-      break;
-    }
-  }
-  ungetc(c, fp);
-}
-
 void _warn_impl(char const* file, int line, char const* func, char const* fmt, ...) {
   va_list args;
   va_start(args, fmt);
@@ -18,8 +18,6 @@
 #define CONCAT4(x, y, z, w) _CONCAT4_I(x, y, z, w)
 #define _CONCAT4_I(x, y, z, w) x ## y ## z ## w
 
-int peek(FILE* fp);
-void skip(FILE* fp);
 void _warn_impl(char const* file, int line, char const* func, char const* fmt, ...);
 
 #define warn(...) \
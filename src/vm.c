@@ -0,0 +1,382 @@
+#include <limits.h>
+#include <stdint.h>
+#include "arena.h"
+#include "bytecode.h"
+#include "host.h"
+#include "vm.h"
+
+struct VmFunction;
+typedef struct VmFunction VmFunction;
+struct VmFrame;
+typedef struct VmFrame VmFrame;
+
+struct VmFunction {
+  int32_t const* code; // into the image
+  int argc;
+  int frame_size;
+  HostFunction const* host; // of undefined ones
+  char const* name;
+};
+
+// a caller waiting for its callee
+struct VmFrame {
+  VmFunction const* func;
+  int32_t const* ret; // where it goes on
+  int* fp;
+  int dst;
+};
+
+// in ints
+int const VM_REGISTERS_SIZE = 1 << 22;
+int const VM_MAX_CALL_DEPTH = 1 << 18;
+
+// registers in range, jumps onto instructions, calls matching their callee's
+// argc and no falling off the end, so the loop needn't check any of it
+bool verify_function(VmFunction const* funcs, int func_count, VmFunction const* f, int length) {
+  bool* const starts = region_alloc(CODEGEN_REGION, length + 1);
+  memset(starts, 0, length + 1);
+  int i = 0;
+  int last = -1;
+  while(i < length) {
+    int32_t const* const inst = f->code + i;
+    // the argc of a call has to be there to know its length
+    int const fixed = inst[0] == BC_CALL ? 4 : 3;
+    if((inst[0] == BC_CALL || inst[0] == BC_TAIL)
+        && (i + fixed > length || inst[fixed - 1] < 0 || inst[fixed - 1] > length)) {
+      break;
+    }
+    int const n = bc_inst_length(inst);
+    if(n == 0 || i + n > length) {
+      break;
+    }
+    starts[i] = true;
+    last = inst[0];
+    i += n;
+  }
+  if(i != length || !(last == BC_JMP || last == BC_TAIL || last == BC_RET || last == BC_RET0)) {
+    warn("broken code in %s\n", f->name);
+    return false;
+  }
+  for(i = 0; i < length; i += bc_inst_length(f->code + i)) {
+    int32_t const* const inst = f->code + i;
+    int const n = bc_inst_length(inst);
+    // which operands are registers, jump targets or functions
+    int reg_begin = 1;
+    int reg_end = n;
+    int target = -1;
+    int callee = -1;
+    switch(inst[0]) {
+    case BC_CONST:
+      reg_end = 2;
+      break;
+    case BC_SHL:
+    case BC_SAR:
+    case BC_SHR:
+      reg_end = 3;
+      break;
+    case BC_JMP:
+      target = 1;
+      reg_end = 1;
+      break;
+    case BC_JZ:
+    case BC_JNZ:
+      target = 2;
+      reg_end = 2;
+      break;
+    case BC_CALL:
+      callee = 2;
+      reg_begin = 4;
+      break;
+    case BC_TAIL:
+      callee = 1;
+      reg_begin = 3;
+      break;
+    case BC_RET0:
+      reg_end = 1;
+      break;
+    }
+    bool ok = true;
+    for(int j = reg_begin; j < reg_end; ++j) {
+      ok = ok && 0 <= inst[j] && inst[j] < f->frame_size;
+    }
+    if(inst[0] == BC_CALL) {
+      ok = ok && 0 <= inst[1] && inst[1] < f->frame_size;
+    }
+    if(target >= 0) {
+      ok = ok && 0 <= inst[target] && inst[target] < length && starts[inst[target]];
+    }
+    if(callee >= 0) {
+      ok = ok && 0 <= inst[callee] && inst[callee] < func_count && funcs[inst[callee]].argc == inst[callee + 1];
+    }
+    if(inst[0] == BC_SHL || inst[0] == BC_SAR || inst[0] == BC_SHR) {
+      ok = ok && 0 <= inst[3] && inst[3] < 32;
+    }
+    if(!ok) {
+      warn("broken %s at %d in %s\n", show_BcOp(inst[0]), i, f->name);
+      return false;
+    }
+  }
+  return true;
+}
+
+// NULL if the image is broken
+VmFunction* load_functions(char const* top, size_t size, int* count) {
+  KbcHeader header;
+  if(size < sizeof(header)) {
+    warn("not a bytecode file\n");
+    return NULL;
+  }
+  memcpy(&header, top, sizeof(header));
+  if(memcmp(header.magic, KBC_MAGIC, sizeof(header.magic)) != 0) {
+    warn("not a bytecode file\n");
+    return NULL;
+  }
+  if(header.version != KBC_VERSION) {
+    warn("bytecode version %u, but this runs %d\n", header.version, KBC_VERSION);
+    return NULL;
+  }
+  uint64_t const code_offset = sizeof(header) + (uint64_t)sizeof(KbcFunction) * header.function_count;
+  uint64_t const strings_offset = code_offset + (uint64_t)sizeof(int32_t) * header.code_size;
+  if(strings_offset + header.string_size != size || header.function_count > INT_MAX) {
+    warn("broken bytecode file\n");
+    return NULL;
+  }
+  KbcFunction const* const kfuncs = (KbcFunction const*)(top + sizeof(header));
+  int32_t const* const code = (int32_t const*)(top + code_offset);
+  char const* const strings = top + strings_offset;
+  // names must end in the strings
+  if(header.string_size != 0 && strings[header.string_size - 1] != '\0') {
+    warn("broken bytecode file\n");
+    return NULL;
+  }
+
+  int const n = header.function_count;
+  VmFunction* const funcs = region_alloc(CODEGEN_REGION, sizeof(VmFunction) * (n + 1));
+  for(int i = 0; i < n; ++i) {
+    KbcFunction const* const kf = &kfuncs[i];
+    VmFunction* const f = &funcs[i];
+    if(kf->name >= header.string_size) {
+      warn("broken bytecode file\n");
+      return NULL;
+    }
+    f->name = strings + kf->name;
+    if(kf->code == KBC_UNDEFINED) {
+      f->host = find_HostFunction(intern_cstr(f->name));
+      if(f->host == NULL) {
+        warn("undefined function: %s\n", f->name);
+        return NULL;
+      }
+      f->code = NULL;
+      f->argc = f->host->argc;
+      f->frame_size = f->argc;
+      continue;
+    }
+    if((uint64_t)kf->code + kf->length > header.code_size || kf->argc > kf->frame_size
+        || kf->frame_size > (uint32_t)VM_REGISTERS_SIZE) {
+      warn("broken bytecode file\n");
+      return NULL;
+    }
+    f->host = NULL;
+    f->code = code + kf->code;
+    f->argc = kf->argc;
+    f->frame_size = kf->frame_size;
+  }
+  for(int i = 0; i < n; ++i) {
+    if(funcs[i].host == NULL && !verify_function(funcs, n, &funcs[i], kfuncs[i].length)) {
+      return NULL;
+    }
+  }
+  *count = n;
+  return funcs;
+}
+
+// direct threading: each instruction jumps to the next one's handler itself
+int execute(VmFunction const* funcs, VmFunction const* entry, int* regs, VmFrame* frames) {
+  static void* const HANDLERS[NUMBER_OF_BC_OPS] = {
+    [BC_CONST] = &&bc_const,
+    [BC_MOV] = &&bc_mov,
+    [BC_ADD] = &&bc_add,
+    [BC_SUB] = &&bc_sub,
+    [BC_MUL] = &&bc_mul,
+    [BC_DIV] = &&bc_div,
+    [BC_EQ] = &&bc_eq,
+    [BC_NEG] = &&bc_neg,
+    [BC_SHL] = &&bc_shl,
+    [BC_SAR] = &&bc_sar,
+    [BC_SHR] = &&bc_shr,
+    [BC_JMP] = &&bc_jmp,
+    [BC_JZ] = &&bc_jz,
+    [BC_JNZ] = &&bc_jnz,
+    [BC_CALL] = &&bc_call,
+    [BC_TAIL] = &&bc_tail,
+    [BC_RET] = &&bc_ret,
+    [BC_RET0] = &&bc_ret0,
+  };
+#define DISPATCH() goto *HANDLERS[*pc]
+  int* const end = regs + VM_REGISTERS_SIZE;
+  VmFunction const* func = entry;
+  int32_t const* pc = entry->code;
+  int* fp = regs;
+  int depth = 0;
+  int value;
+  DISPATCH();
+
+  // arithmetic wraps around like the generated code's
+bc_const:
+  fp[pc[1]] = pc[2];
+  pc += 3;
+  DISPATCH();
+bc_mov:
+  fp[pc[1]] = fp[pc[2]];
+  pc += 3;
+  DISPATCH();
+bc_add:
+  fp[pc[1]] = (int)((unsigned)fp[pc[2]] + (unsigned)fp[pc[3]]);
+  pc += 4;
+  DISPATCH();
+bc_sub:
+  fp[pc[1]] = (int)((unsigned)fp[pc[2]] - (unsigned)fp[pc[3]]);
+  pc += 4;
+  DISPATCH();
+bc_mul:
+  fp[pc[1]] = (int)((unsigned)fp[pc[2]] * (unsigned)fp[pc[3]]);
+  pc += 4;
+  DISPATCH();
+bc_div: {
+  int const a = fp[pc[2]];
+  int const b = fp[pc[3]];
+  if(b == 0 || (a == INT_MIN && b == -1)) {
+    warn("division overflow in %s\n", func->name);
+    return 1;
+  }
+  fp[pc[1]] = a / b;
+  pc += 4;
+  DISPATCH();
+}
+bc_eq:
+  fp[pc[1]] = fp[pc[2]] == fp[pc[3]];
+  pc += 4;
+  DISPATCH();
+bc_neg:
+  fp[pc[1]] = (int)(0u - (unsigned)fp[pc[2]]);
+  pc += 3;
+  DISPATCH();
+bc_shl:
+  fp[pc[1]] = (int)((unsigned)fp[pc[2]] << pc[3]);
+  pc += 4;
+  DISPATCH();
+bc_sar:
+  fp[pc[1]] = fp[pc[2]] >> pc[3];
+  pc += 4;
+  DISPATCH();
+bc_shr:
+  fp[pc[1]] = (int)((unsigned)fp[pc[2]] >> pc[3]);
+  pc += 4;
+  DISPATCH();
+bc_jmp:
+  pc = func->code + pc[1];
+  DISPATCH();
+bc_jz:
+  pc = fp[pc[1]] == 0 ? func->code + pc[2] : pc + 3;
+  DISPATCH();
+bc_jnz:
+  pc = fp[pc[1]] != 0 ? func->code + pc[2] : pc + 3;
+  DISPATCH();
+bc_call: {
+  VmFunction const* const callee = &funcs[pc[2]];
+  int const argc = pc[3];
+  int32_t const* const args = pc + 4;
+  if(callee->host != NULL) {
+    int host_args[6]; // no host function takes more
+    for(int i = 0; i < argc; ++i) {
+      host_args[i] = fp[args[i]];
+    }
+    fp[pc[1]] = call_HostFunction(callee->host, host_args);
+    pc += 4 + argc;
+    DISPATCH();
+  }
+  // the callee's frame starts right after ours
+  int* const callee_fp = fp + func->frame_size;
+  if(callee->frame_size > end - callee_fp || depth == VM_MAX_CALL_DEPTH) {
+    warn("stack overflow in %s\n", callee->name);
+    return 1;
+  }
+  for(int i = 0; i < argc; ++i) {
+    callee_fp[i] = fp[args[i]];
+  }
+  VmFrame* const frame = &frames[depth++];
+  frame->func = func;
+  frame->ret = pc + 4 + argc;
+  frame->fp = fp;
+  frame->dst = pc[1];
+  func = callee;
+  fp = callee_fp;
+  pc = callee->code;
+  DISPATCH();
+}
+bc_tail: {
+  VmFunction const* const callee = &funcs[pc[1]];
+  int const argc = pc[2];
+  int32_t const* const args = pc + 3;
+  if(callee->host != NULL) {
+    int host_args[6];
+    for(int i = 0; i < argc; ++i) {
+      host_args[i] = fp[args[i]];
+    }
+    value = call_HostFunction(callee->host, host_args);
+    goto ret;
+  }
+  // the callee takes over our frame. its args may be read from registers they
+  // overwrite, so they are gathered after the frame first
+  int* const scratch = fp + func->frame_size;
+  if(argc > end - scratch || callee->frame_size > end - fp) {
+    warn("stack overflow in %s\n", callee->name);
+    return 1;
+  }
+  for(int i = 0; i < argc; ++i) {
+    scratch[i] = fp[args[i]];
+  }
+  memmove(fp, scratch, sizeof(int) * argc);
+  func = callee;
+  pc = callee->code;
+  DISPATCH();
+}
+bc_ret:
+  value = fp[pc[1]];
+  goto ret;
+bc_ret0:
+  value = 0;
+ret: {
+  if(depth == 0) {
+    return value;
+  }
+  VmFrame const* const frame = &frames[--depth];
+  func = frame->func;
+  fp = frame->fp;
+  fp[frame->dst] = value;
+  pc = frame->ret;
+  DISPATCH();
+}
+#undef DISPATCH
+}
+
+int run_bytecode(char const* top, size_t size) {
+  int count;
+  VmFunction const* const funcs = load_functions(top, size, &count);
+  if(funcs == NULL) {
+    return 1;
+  }
+  VmFunction const* entry = NULL;
+  for(int i = 0; i < count; ++i) {
+    if(funcs[i].host == NULL && strcmp(funcs[i].name, "main") == 0) {
+      entry = &funcs[i];
+    }
+  }
+  if(entry == NULL || entry->argc != 0) {
+    warn("no main\n");
+    return 1;
+  }
+  int* const regs = region_alloc(CODEGEN_REGION, sizeof(int) * VM_REGISTERS_SIZE);
+  VmFrame* const frames = region_alloc(CODEGEN_REGION, sizeof(VmFrame) * VM_MAX_CALL_DEPTH);
+  return execute(funcs, entry, regs, frames);
+}
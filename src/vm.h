@@ -0,0 +1,11 @@
+#ifndef NNA774_KONOHA_VM_H
+#define NNA774_KONOHA_VM_H
+
+#include <stddef.h>
+
+// runs main of the .kbc image of size bytes at top(see bytecode.h), which may be
+// mapped read-only, and returns what it returns. the image is checked first, so
+// running trusts it. calls to undefined functions go to the host ones(see host.h)
+int run_bytecode(char const* top, size_t size);
+
+#endif // NNA774_KONOHA_VM_H
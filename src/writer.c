@@ -0,0 +1,144 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "writer.h"
+
+size_t const WRITER_BUFFER_SIZE = 256 * 1024;
+int const MAX_INT_LEN = 11; // "-2147483648"
+
+Writer* new_Writer(FILE* fp) {
+  assert(fp != NULL);
+  Writer* const w = malloc(sizeof(Writer));
+  w->fp = fp;
+  w->buf = malloc(WRITER_BUFFER_SIZE);
+  w->length = 0;
+  w->capacity = WRITER_BUFFER_SIZE;
+  return w;
+}
+
+Writer* new_buffer_Writer() {
+  Writer* const w = malloc(sizeof(Writer));
+  w->fp = NULL;
+  w->buf = malloc(WRITER_BUFFER_SIZE);
+  w->length = 0;
+  w->capacity = WRITER_BUFFER_SIZE;
+  return w;
+}
+
+void grow_Writer(Writer* w, size_t n) {
+  while(w->capacity < w->length + n) {
+    w->capacity *= 2;
+  }
+  char* const buf = realloc(w->buf, w->capacity);
+  assert(buf != NULL);
+  w->buf = buf;
+}
+
+void flush_Writer(Writer* w) {
+  if(w->fp == NULL) {
+    return;
+  }
+  if(w->length != 0) {
+    fwrite(w->buf, 1, w->length, w->fp);
+    w->length = 0;
+  }
+  fflush(w->fp);
+}
+
+void write_bytes(Writer* w, char const* s, size_t n) {
+  if(w->length + n > w->capacity) {
+    if(w->fp == NULL) {
+      grow_Writer(w, n);
+    } else {
+      flush_Writer(w);
+      if(n > w->capacity) {
+        fwrite(s, 1, n, w->fp);
+        return;
+      }
+    }
+  }
+  memcpy(w->buf + w->length, s, n);
+  w->length += n;
+}
+
+void write_str(Writer* w, char const* s) {
+  write_bytes(w, s, strlen(s));
+}
+
+void write_char(Writer* w, char c) {
+  if(w->length == w->capacity) {
+    if(w->fp == NULL) {
+      grow_Writer(w, 1);
+    } else {
+      flush_Writer(w);
+    }
+  }
+  w->buf[w->length++] = c;
+}
+
+void append_Writer(Writer* dst, Writer const* src) {
+  write_bytes(dst, src->buf, src->length);
+}
+
+void reset_Writer(Writer* w) {
+  w->length = 0;
+}
+
+char* format_int(char* buf, int n) {
+  char tmp[MAX_INT_LEN];
+  unsigned int u = n < 0 ? -(unsigned int)n : (unsigned int)n;
+  int len = 0;
+  do {
+    tmp[len++] = '0' + u % 10;
+    u /= 10;
+  } while(u != 0);
+  if(n < 0) {
+    *buf++ = '-';
+  }
+  while(len != 0) {
+    *buf++ = tmp[--len];
+  }
+  return buf;
+}
+
+void write_int(Writer* w, int n) {
+  char buf[MAX_INT_LEN];
+  char* const end = format_int(buf, n);
+  write_bytes(w, buf, end - buf);
+}
+
+void writef(Writer* w, char const* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  char const* lit = fmt;
+  char const* p = fmt;
+  while(*p != '\0') {
+    if(*p != '%') {
+      ++p;
+      continue;
+    }
+    write_bytes(w, lit, p - lit);
+    switch(p[1]) {
+    case 's':
+      write_str(w, va_arg(args, char const*));
+      break;
+    case 'd':
+      write_int(w, va_arg(args, int));
+      break;
+    case 'c':
+      write_char(w, (char)va_arg(args, int));
+      break;
+    case '%':
+      write_char(w, '%');
+      break;
+    default:
+      warn("unsupported format(%s)\n", p);
+      va_end(args);
+      return;
+    }
+    p += 2;
+    lit = p;
+  }
+  write_bytes(w, lit, p - lit);
+  va_end(args);
+}
@@ -0,0 +1,36 @@
+#ifndef NNA774_KONOHA_WRITER_H
+#define NNA774_KONOHA_WRITER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "utils.h"
+
+// buffered output. flushes to `fp` only when the buffer is full
+// or flush_Writer is called.
+// a Writer without `fp`(new_buffer_Writer) just grows in memory.
+struct Writer;
+typedef struct Writer Writer;
+
+struct Writer {
+  FILE* fp;
+  char* buf;
+  size_t length;
+  size_t capacity;
+};
+
+Writer* new_Writer(FILE* fp);
+Writer* new_buffer_Writer();
+void flush_Writer(Writer*);
+void append_Writer(Writer* dst, Writer const* src);
+void reset_Writer(Writer*);
+void write_bytes(Writer*, char const*, size_t);
+void write_str(Writer*, char const*);
+void write_char(Writer*, char);
+void write_int(Writer*, int);
+// understands only %s, %d, %c and %%
+void writef(Writer*, char const* fmt, ...);
+
+// writes decimal `n` to `buf`(no NUL), returns the end
+char* format_int(char* buf, int n);
+
+#endif // NNA774_KONOHA_WRITER_H
@@ -0,0 +1,294 @@
+#include "arena.h"
+#include "x86.h"
+
+char const* const REG32_NAMES[] = {
+  "%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi",
+  "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d",
+};
+char const* const REG64_NAMES[] = {
+  "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+  "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15",
+};
+char const* const REG8_NAMES[] = {
+  "%al", "%cl", "%dl", "%bl", "%spl", "%bpl", "%sil", "%dil",
+  "%r8b", "%r9b", "%r10b", "%r11b", "%r12b", "%r13b", "%r14b", "%r15b",
+};
+
+Reg const REGS[] = {RDI, RSI, RDX, RCX, R8, R9};
+Reg const CALLEE_SAVED_REGS[] = {RBX, R12, R13, R14, R15};
+int const NUMBER_OF_CALLEE_SAVED_REGS = sizeof(CALLEE_SAVED_REGS) / sizeof(*CALLEE_SAVED_REGS);
+unsigned const CALLEE_SAVED_MASK = 1u << RBX | 1u << R12 | 1u << R13 | 1u << R14 | 1u << R15;
+unsigned const CALLER_SAVED_MASK = 1u << RAX | 1u << RCX | 1u << RDX | 1u << RSI | 1u << RDI
+  | 1u << R8 | 1u << R9 | 1u << R10 | 1u << R11;
+
+Operand reg_operand(Reg r) {
+  Operand const o = { REG_OPERAND, r };
+  return o;
+}
+
+Operand imm_operand(int n) {
+  Operand const o = { IMM_OPERAND, n };
+  return o;
+}
+
+Operand slot_operand(int offset) {
+  Operand const o = { SLOT_OPERAND, offset };
+  return o;
+}
+
+bool same_operand(Operand x, Operand y) {
+  return x.type == y.type && x.val == y.val;
+}
+
+X86Func* new_X86Func(Symbol name) {
+  X86Func* const f = region_alloc(CODEGEN_REGION, sizeof(X86Func));
+  f->name = name;
+  f->insts = NULL;
+  f->count = 0;
+  f->capacity = 0;
+  f->frame_pointer = false;
+  f->frame_size = 0;
+  return f;
+}
+
+X86Inst* append_X86Inst(X86Func* f, X86Op op) {
+  GROW_ARRAY(X86Inst, f->insts, f->count, f->capacity, 64);
+  X86Inst* const inst = &f->insts[f->count++];
+  memset(inst, 0, sizeof(X86Inst));
+  inst->op = op;
+  return inst;
+}
+
+void compact_X86Func(X86Func* f) {
+  int n = 0;
+  for(int i = 0; i < f->count; ++i) {
+    if(f->insts[i].op != X86_NOP) {
+      f->insts[n++] = f->insts[i];
+    }
+  }
+  f->count = n;
+}
+
+// %rsp and %rbp only ever hold the frame, so they aren't tracked
+unsigned operand_regs(Operand o) {
+  if(o.type != REG_OPERAND) {
+    return 0;
+  }
+  return REG_BIT(o.val) & ~(REG_BIT(RSP) | REG_BIT(RBP));
+}
+
+unsigned argument_regs(int argc) {
+  unsigned regs = 0;
+  for(int i = 0; i < argc && i < 6; ++i) {
+    regs |= REG_BIT(REGS[i]);
+  }
+  return regs;
+}
+
+unsigned X86Inst_uses(X86Inst const* inst) {
+  switch(inst->op) {
+  case X86_MOVL:
+  case X86_MOVQ:
+  case X86_MOVZBL:
+  case X86_PUSHQ:
+    return operand_regs(inst->src);
+  case X86_ADDL:
+  case X86_SUBL:
+  case X86_IMULL:
+  case X86_CMPL:
+  case X86_SHLL:
+  case X86_SARL:
+  case X86_SHRL:
+    return operand_regs(inst->src) | operand_regs(inst->dst);
+  case X86_NEGL:
+  case X86_SETE: // keeps the upper bits
+    return operand_regs(inst->dst);
+  case X86_CLTD:
+    return REG_BIT(RAX);
+  case X86_IDIVL:
+    return operand_regs(inst->src) | REG_BIT(RAX) | REG_BIT(RDX);
+  case X86_CALL:
+    return argument_regs(inst->call.argc);
+  case X86_TAIL:
+    return argument_regs(inst->call.argc) | CALLEE_SAVED_MASK;
+  case X86_RET:
+    return REG_BIT(RAX) | CALLEE_SAVED_MASK;
+  default:
+    return 0;
+  }
+}
+
+unsigned X86Inst_defs(X86Inst const* inst) {
+  switch(inst->op) {
+  case X86_MOVL:
+  case X86_MOVQ:
+  case X86_MOVZBL:
+  case X86_ADDL:
+  case X86_SUBL:
+  case X86_IMULL:
+  case X86_SHLL:
+  case X86_SARL:
+  case X86_SHRL:
+  case X86_NEGL:
+  case X86_SETE:
+  case X86_POPQ:
+    return operand_regs(inst->dst);
+  case X86_CLTD:
+    return REG_BIT(RDX);
+  case X86_IDIVL:
+    return REG_BIT(RAX) | REG_BIT(RDX);
+  case X86_CALL:
+    return CALLER_SAVED_MASK;
+  default:
+    return 0;
+  }
+}
+
+bool is_jump(X86Op op) {
+  return op == X86_JMP || op == X86_JE || op == X86_JNE;
+}
+
+// without a frame pointer %rsp sits frame_size below the frame top
+// (and a leaf function keeps its slots in the red zone)
+Reg slot_base(X86Func const* f) {
+  return f->frame_pointer ? RBP : RSP;
+}
+
+int slot_displacement(X86Func const* f, int offset) {
+  return f->frame_pointer ? -offset : f->frame_size - offset;
+}
+
+char const* X86Op_mnemonic(X86Op op) {
+  switch(op) {
+  case X86_MOVL:
+    return "movl";
+  case X86_MOVQ:
+    return "movq";
+  case X86_ADDL:
+    return "addl";
+  case X86_SUBL:
+    return "subl";
+  case X86_IMULL:
+    return "imull";
+  case X86_CMPL:
+    return "cmpl";
+  case X86_SHLL:
+    return "shll";
+  case X86_SARL:
+    return "sarl";
+  case X86_SHRL:
+    return "shrl";
+  case X86_NEGL:
+    return "negl";
+  case X86_CLTD:
+    return "cltd";
+  case X86_IDIVL:
+    return "idivl";
+  case X86_SETE:
+    return "sete";
+  case X86_MOVZBL:
+    return "movzbl";
+  case X86_ADDQ:
+    return "addq";
+  case X86_SUBQ:
+    return "subq";
+  case X86_PUSHQ:
+    return "pushq";
+  case X86_POPQ:
+    return "popq";
+  case X86_CALL:
+    return "call";
+  case X86_TAIL:
+  case X86_JMP:
+    return "jmp";
+  case X86_RET:
+    return "ret";
+  case X86_JE:
+    return "je";
+  case X86_JNE:
+    return "jne";
+  case X86_LABEL:
+  case X86_COMMENT:
+  case X86_NOP:
+    break;
+  }
+  return "";
+}
+
+// size is in bytes(1, 4 or 8)
+void write_X86Operand(Writer* w, X86Func const* f, Operand o, int size) {
+  switch(o.type) {
+  case REG_OPERAND:
+    write_str(w, (size == 1 ? REG8_NAMES : size == 8 ? REG64_NAMES : REG32_NAMES)[o.val]);
+    break;
+  case IMM_OPERAND:
+    write_char(w, '$');
+    write_int(w, o.val);
+    break;
+  case SLOT_OPERAND: {
+    int const disp = slot_displacement(f, o.val);
+    if(disp != 0) {
+      write_int(w, disp);
+    }
+    writef(w, "(%s)", REG64_NAMES[slot_base(f)]);
+    break;
+  }
+  }
+}
+
+void write_X86Inst(Writer* w, X86Func const* f, X86Inst const* inst) {
+  switch(inst->op) {
+  case X86_LABEL:
+    writef(w, ".L%d:\n", inst->label);
+    return;
+  case X86_COMMENT:
+    writef(w, "# %s\n", inst->comment);
+    return;
+  case X86_NOP:
+    return;
+  default:
+    break;
+  }
+  writef(w, "\t%s", X86Op_mnemonic(inst->op));
+  switch(inst->op) {
+  case X86_CLTD:
+  case X86_RET:
+    break;
+  case X86_CALL:
+  case X86_TAIL:
+    writef(w, " %s", inst->call.name);
+    break;
+  case X86_JMP:
+  case X86_JE:
+  case X86_JNE:
+    writef(w, " .L%d", inst->label);
+    break;
+  case X86_IDIVL:
+  case X86_PUSHQ:
+    write_char(w, ' ');
+    write_X86Operand(w, f, inst->src, inst->op == X86_PUSHQ ? 8 : 4);
+    break;
+  case X86_NEGL:
+  case X86_SETE:
+  case X86_POPQ:
+    write_char(w, ' ');
+    write_X86Operand(w, f, inst->dst, inst->op == X86_SETE ? 1 : inst->op == X86_POPQ ? 8 : 4);
+    break;
+  default: {
+    bool const quad = inst->op == X86_MOVQ || inst->op == X86_ADDQ || inst->op == X86_SUBQ;
+    write_char(w, ' ');
+    write_X86Operand(w, f, inst->src, quad ? 8 : inst->op == X86_MOVZBL ? 1 : 4);
+    write_str(w, ", ");
+    write_X86Operand(w, f, inst->dst, quad ? 8 : 4);
+    break;
+  }
+  }
+  write_char(w, '\n');
+}
+
+void write_X86Func(Writer* w, X86Func const* f) {
+  writef(w, "\t.global %s\n%s:\n", f->name, f->name);
+  for(int i = 0; i < f->count; ++i) {
+    write_X86Inst(w, f, &f->insts[i]);
+  }
+}
@@ -0,0 +1,127 @@
+#ifndef NNA774_KONOHA_X86_H
+#define NNA774_KONOHA_X86_H
+
+#include "enum.h"
+#include "symbol.h"
+#include "writer.h"
+
+// x86-64 code of a function as a list of instructions, not text.
+// emit builds it, peephole rewrites it, and write_X86Func prints it last
+
+// register numbers(in encoding order)
+enum Reg {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+  NUMBER_OF_REGS,
+};
+typedef enum Reg Reg;
+
+#define REG_BIT(r) (1u << (r))
+
+// argument registers, in order
+extern Reg const REGS[];
+extern Reg const CALLEE_SAVED_REGS[];
+extern int const NUMBER_OF_CALLEE_SAVED_REGS;
+extern unsigned const CALLEE_SAVED_MASK;
+extern unsigned const CALLER_SAVED_MASK;
+
+enum OperandType {
+  REG_OPERAND,
+  IMM_OPERAND,
+  SLOT_OPERAND, // val bytes below the top of the frame(see slot_address)
+};
+typedef enum OperandType OperandType;
+
+struct Operand;
+typedef struct Operand Operand;
+
+struct Operand {
+  OperandType type;
+  int val; // Reg, immediate or offset
+};
+
+Operand reg_operand(Reg);
+Operand imm_operand(int);
+Operand slot_operand(int offset);
+bool same_operand(Operand, Operand);
+
+// the suffix is the operand size. registers print as 32 bits
+// except with the q ones(64), sete's and movzbl's source(8)
+ENUM_WITH_SHOW(
+  X86Op,
+  X86_MOVL,   // src -> dst
+  X86_MOVQ,
+  X86_ADDL,   // dst += src
+  X86_SUBL,
+  X86_IMULL,
+  X86_CMPL,   // flags for dst - src
+  X86_SHLL,   // dst <<= src(an immediate)
+  X86_SARL,
+  X86_SHRL,
+  X86_NEGL,   // dst = -dst
+  X86_CLTD,   // %edx = sign of %eax
+  X86_IDIVL,  // %eax, %edx = %edx:%eax / src, %edx:%eax % src
+  X86_SETE,   // dst(8 bits) = ZF
+  X86_MOVZBL, // src(8 bits) -> dst
+  X86_ADDQ,
+  X86_SUBQ,
+  X86_PUSHQ,  // src
+  X86_POPQ,   // dst
+  X86_CALL,   // call.name, reading call.argc argument registers
+  X86_TAIL,   // jmp call.name, the same way(a tail call)
+  X86_RET,
+  X86_JMP,    // to label
+  X86_JE,
+  X86_JNE,
+  X86_LABEL,  // .L<label>:
+  X86_COMMENT,
+  X86_NOP,    // removed by compact_X86Func
+)
+
+struct X86Inst;
+typedef struct X86Inst X86Inst;
+struct X86Func;
+typedef struct X86Func X86Func;
+
+struct X86Inst {
+  X86Op op;
+  Operand src;
+  Operand dst;
+  union {
+    int label;
+    struct {
+      Symbol name;
+      int argc;
+    } call;
+    char const* comment;
+  };
+};
+
+struct X86Func {
+  Symbol name;
+  X86Inst* insts;
+  int count;
+  int capacity;
+  bool frame_pointer; // slots are off %rbp, otherwise off %rsp
+  int frame_size; // %rsp is this far below the frame top after the prologue
+};
+
+X86Func* new_X86Func(Symbol name);
+// the new instruction has no operands
+X86Inst* append_X86Inst(X86Func*, X86Op);
+void compact_X86Func(X86Func*);
+
+// registers read and written by inst, as REG_BITs. %rsp and %rbp are left out
+unsigned X86Inst_uses(X86Inst const*);
+unsigned X86Inst_defs(X86Inst const*);
+bool is_jump(X86Op);
+
+// base register and displacement of a slot
+Reg slot_base(X86Func const*);
+int slot_displacement(X86Func const*, int offset);
+
+char const* X86Op_mnemonic(X86Op);
+void write_X86Inst(Writer*, X86Func const*, X86Inst const*);
+void write_X86Func(Writer*, X86Func const*);
+
+#endif // NNA774_KONOHA_X86_H
@@ -1,27 +1,48 @@
 #! /bin/bash -x
 
 konoha=./konoha
+flags=
 
 compile() {
-    echo "$1" | "$konoha" -o tmp/out.s
+    # -c writes an object file instead of assembly
+    out=tmp/out.s
+    case " $KONOHA_FLAGS $flags " in
+	*" -c "*) out=tmp/out.o ;;
+    esac
+    echo "$1" | "$konoha" $KONOHA_FLAGS $flags -o $out
     if [ $? != 0 ]; then
 	echo "compilation fail"
 	exit -1
     fi
-    "$CC" tmp/out.s driver.c self_driver.s -o tmp/a.out
+    "$CC" $out driver.c self_driver.s -o tmp/a.out
     if [ $? != 0 ]; then
 	echo "$CC fail"
 	exit -1
     fi
 }
 
+# the last of -r, -e and -b, which is the one konoha follows
+run_mode() {
+    mode=
+    for f in $KONOHA_FLAGS $flags; do
+	case "$f" in
+	    -r|-e|-b) mode="$f" ;;
+	esac
+    done
+    printf "%s" "$mode"
+}
+
 test() {
     expected="$1"
     expr="$2"
     : test "expected $expected, expr $expr"
 
-    compile "$expr"
-    res=`./tmp/a.out`
+    # -r and -e run it in process, and -b through the bytecode VM
+    case `run_mode` in
+	-b) echo "$expr" | "$konoha" $KONOHA_FLAGS $flags -o tmp/out.kbc && res=`"$konoha" -x tmp/out.kbc` ;;
+	-r|-e) res=`echo "$expr" | "$konoha" $KONOHA_FLAGS $flags` ;;
+	*) compile "$expr"; res=`./tmp/a.out` ;;
+    esac
     ret=$?
     if [ $ret != 0 ]; then
         echo "got nonzero return code($ret)"
@@ -33,6 +54,41 @@ test() {
     : ok
 }
 
+# the program has to die(SIGFPE, or exit nonzero with -r, -e and -b)
+test_trap() {
+    expr="$1"
+    : test_trap "expr $expr"
+
+    case `run_mode` in
+	-b) echo "$expr" | "$konoha" $KONOHA_FLAGS $flags -o tmp/out.kbc && "$konoha" -x tmp/out.kbc ;;
+	-r|-e) echo "$expr" | "$konoha" $KONOHA_FLAGS $flags ;;
+	*) compile "$expr"; ./tmp/a.out ;;
+    esac
+    if [ $? == 0 ]; then
+	echo "Test failed: expected a trap"
+	exit -1
+    fi
+    : ok
+}
+
+test_with_flags() {
+    flags="$1"
+    test "$2" "$3"
+    flags=
+}
+
+test_trap_with_flags() {
+    flags="$1"
+    test_trap "$2"
+    flags=
+}
+
+test_ir_with_flags() {
+    flags="$1"
+    test_ir "$2" "$3"
+    flags=
+}
+
 test_ast() {
     expected="$1"
     expr="$2"
@@ -50,6 +106,68 @@ test_ast() {
     : ok
 }
 
+test_tokenize() {
+    expected="$1"
+    expr="$2"
+    : test_tokenize "expected $expected, expr $expr"
+
+    res=`echo "$expr" | "$konoha" -t | tail -n +2 | tr '\n' ' '`
+    if [ $? != 0 ]; then
+	echo "execution fail"
+	exit -1
+    fi
+    if [ "x$res" != "x$expected" ]; then
+	echo "Test failed: expected $expected, but got $res"
+	exit -1
+    fi
+    : ok
+}
+
+test_ir() {
+    expected="$1"
+    expr="$2"
+    : test_ir "expected $expected, expr $expr"
+
+    res=`echo "$expr" | "$konoha" -i $flags | tr -d '\t' | tr '\n' ' '`
+    if [ $? != 0 ]; then
+	echo "execution fail"
+	exit -1
+    fi
+    if [ "x$res" != "x$expected" ]; then
+	echo "Test failed: expected $expected, but got $res"
+	exit -1
+    fi
+    : ok
+}
+
+test_asm() {
+    expected="$1"
+    expr="$2"
+    : test_asm "expected $expected, expr $expr"
+
+    res=`echo "$expr" | "$konoha" $flags | tr -d '\t' | tr '\n' ' '`
+    if [ $? != 0 ]; then
+	echo "execution fail"
+	exit -1
+    fi
+    if [ "x$res" != "x$expected" ]; then
+	echo "Test failed: expected $expected, but got $res"
+	exit -1
+    fi
+    : ok
+}
+
+test_asm_with_flags() {
+    flags="$1"
+    test_asm "$2" "$3"
+    flags=
+}
+
+test_tokenize "KEYWORD_T: int IDENTIFIER_T: a SEMICOLON_T: ; EOF_T:  " "int a;"
+test_tokenize "KEYWORD_T: while IDENTIFIER_T: whilst KEYWORD_T: sizeof IDENTIFIER_T: sizeo IDENTIFIER_T: iff EOF_T:  " "while whilst sizeof sizeo iff"
+test_tokenize "IDENTIFIER_T: a OP_EQUAL_T: == INTEGER_LITERAL_T: 42 EOF_T:  " "a == 42 // comment"
+test_tokenize "IDENTIFIER_T: a OP_ASSIGN_T: = CHARACTER_LITERAL_T: x SEMICOLON_T: ; EOF_T:  " "a /* b */ = 'x';"
+
 test_ast "(defun f<int()> () (do ))" "int f() {}"
 test_ast "(defun f<int(int)> (n) (do ))" "int f(int n) {}"
 test_ast "(defun f<int(int, int)> (n, m) (do ))" "int f(int n, int m) {}"
@@ -154,6 +272,22 @@ if(1)
 
 test_ast "(defun main<int()> () (do (defvar a)(do (let a 1))))" "int main() {int a; { a = 1; } }"
 
+test_ir "f(2): b0: %0 = param 0 %1 = param 1 %2 = add %0, %1 ret %2 " "int f(int a, int b) { return a + b; }"
+test_ir "main(0): b0: %0 = const 3 ret %0 " "int main() { return 1 + 2; }"
+test_ir "f(1): b0: %0 = param 0 ret %0 " "int f(int a) { return a * 1 + 0 - (a - a); }"
+test_ir "f(1): b0: %0 = param 0 %1 = neg %0 ret %1 " "int f(int a) { return -a; }"
+test_ir "f(1): b0: %0 = param 0 ret %0 " "int f(int a) { return a; a = a + 1; print_int(a); }"
+test_ir "f(1): b0: %0 = param 0 br %0, b1, b2 b1: %1 = const 1 ret %1 b2: %2 = const 2 ret %2 " "int f(int a) { if(a) { return 1; } else { return 2; } }"
+test_ir_with_flags "-O1" "f(1): b0: %0 = param 0 ret %0 " "int f(int a) { int b; int c; b = a * 3; c = b + 1; b = 5; return a; }"
+test_ir_with_flags "-O1" "f(1): b0: %0 = param 0 %9 = mov %0 jmp b1 b1: %1 = mov %9 %2 = const 0 %3 = eq %1, %2 br %3, b2, b3 b2: %8 = const 0 ret %8 b3: %4 = const 1 %5 = sub %1, %4 %9 = mov %5 jmp b1 " "int f(int n) { if(n == 0) return 0; return f(n - 1); }"
+test_ir_with_flags "-O2" "sq(1): b0: %0 = param 0 %1 = mul %0, %0 ret %1 f(1): b0: %0 = param 0 %2 = mul %0, %0 %4 = const 1 %5 = add %2, %4 ret %5 " "int sq(int x) { return x * x; } int f(int a) { return sq(a) + 1; }"
+test_ir_with_flags "-O2 -finline-limit=2" "sq(1): b0: %0 = param 0 %1 = mul %0, %0 ret %1 f(1): b0: %0 = param 0 %1 = call sq(%0) %2 = const 1 %3 = add %1, %2 ret %3 " "int sq(int x) { return x * x; } int f(int a) { return sq(a) + 1; }"
+test_ir "f(1): b0: %0 = param 0 %1 = shl %0, 3 ret %1 " "int f(int a) { return a * 8; }"
+test_ir "f(1): b0: %0 = param 0 %1 = sar %0, 31 %2 = shr %1, 30 %3 = add %0, %2 %4 = sar %3, 2 ret %4 " "int f(int a) { return a / 4; }"
+test_ir "f(1): b0: %0 = param 0 %1 = mov %0 jmp b2 b1: %2 = const 1 %3 = sub %1, %2 %1 = mov %3 jmp b2 b2: br %1, b1, b3 b3: ret %1 " "int f(int a) { int b; b = a; while(b) { b = b - 1; } return b; }"
+# -O1: b is in SSA form while optimized, then its phi becomes copies
+test_ir_with_flags "-O1" "f(1): b0: %0 = param 0 %6 = mov %0 br %0, b1, b2 b1: %2 = const 1 %3 = add %0, %2 %6 = mov %3 jmp b2 b2: %5 = mov %6 ret %5 " "int f(int a) { int b; b = a; if(a) { b = b + 1; } return b; }"
+
 test "0" "int main() {print_int(0);}"
 test "42" "int main() {print_int(42);}"
 test "100" "int main() {print_int(100);}"
@@ -269,3 +403,87 @@ test "a" "int main() {
   print_char(a);
   return 0;
 }"
+
+# register allocation: more locals than registers, deep trees and calls inside operands
+test "-720" "int main() {
+  int a; int b; int c; int d; int e; int f; int g; int h;
+  a = 1; b = 2; c = 3; d = 4; e = 5; f = 6; g = 7; h = 8;
+  print_int((a+(b+(c+(d+(e+(f+(g+h))))))) * ((h-g)-(f-e)) - (a*b)*(c*d)*(e*f));
+}"
+test "5" "int main() { int a; a = 1; print_int((8 / (4 / (2 / a))) + ((a+2)/(3/(11/(5-6+7))))); }"
+test "-39" "int f3(int a, int b, int c) { return a * 100 + b * 10 + c; }
+int main() { int a; a = 1; print_int(f3(a - 2, (2 - 3) * (4 - 5), 10 / (6 - 5)) + f3(1, 2, 3) / f3(0, 0, 3)); }"
+test "5050" "int main() { int s; int i; s = 0; i = 100; while(i) { s = s + i; i = i - 1; } print_int(s); }"
+test "-3-3-1-1" "int half(int a) { return a / 2; } int quarter(int a) { return a / 4; } int main() { print_int(half(0-7)); print_int(quarter(0-13)); print_int(half(0-3)); print_int(quarter(0-4)); }"
+test "-2147483648" "int main() { print_int(2147483647 + 1); }"
+test "01234" "int main() { int i; i = 0; while((i == 5) == 0) { print_int(i); i = i + 1; } }"
+test "11" "int main() { int a; int e; a = 3; e = a == 3; if(e) { print_int(e); } if(a == 3) print_int(1); else print_int(0); }"
+test "-2147483648" "int main() { int a; a = 0 - 2147483647 - 1; print_int(a / 1 * 1); }"
+# x/-1 isn't folded into a neg, which wouldn't trap
+test_trap "int f(int x) { return x / (0 - 1); } int main() { print_int(f(0 - 2147483647 - 1)); return 0; }"
+test "531" "int f(int x) { int a; int b; int c; int d; int e; int g; int h; int i; int j; int s;
+  a = x + 1; b = x + 2; c = x + 3; d = x + 4; e = x + 5; g = x + 6; h = x + 7; i = x + 8; j = x + 9;
+  s = a + b + c + d + e + g + h + i + j;
+  a = s + 1; b = s + 2; c = s + 3; d = s + 4; e = s + 5; g = s + 6; h = s + 7; i = s + 8; j = s + 9;
+  return a + b + c + d + e + g + h + i + j; }
+int main() { print_int(f(1)); }"
+test "-4212" "int f(int a) { return -a * 4 + (a - a); } int main() { print_int(f(1053)); }"
+
+# -g puts each IR instruction before the code lowered from it
+test_asm_with_flags "-g" ".text .global f f: # %0 = param 0 # %1 = param 1 movl %edi, %ecx # %2 = const 42 movl \$42, %edi # %3 = eq %0, %2 cmpl %edi, %ecx # br %3, b1, b2 jne .L2 .L1: # ret %1 movl %esi, %eax ret .L2: # %4 = const 1 movl \$1, %esi # %5 = add %0, %4 addl %esi, %ecx # ret %5 movl %ecx, %eax ret " "int f(int a, int b) { if(a == 42) return b; return a + 1; }"
+test_asm_with_flags "-g -O1" ".text .global f f: # %0 = param 0 # %1 = param 1 movl %edi, %ecx # %2 = const 42 # %3 = eq %0, %2 cmpl \$42, %ecx # br %3, b1, b2 jne .L2 .L1: # ret %1 movl %esi, %eax ret .L2: # %4 = const 1 # %5 = add %0, %4 addl \$1, %ecx # ret %5 movl %ecx, %eax ret " "int f(int a, int b) { if(a == 42) return b; return a + 1; }"
+test "300120" "int sq(int x) { return x * x; }
+int absd(int a, int b) { if(a == b) { return 0; } return a - b; }
+int fact(int n) { if(n == 0) return 1; return n * fact(n - 1); }
+int main() { int i; int s; i = 0; s = 0; while((i == 10) == 0) { s = s + sq(i) + absd(i, 3); i = i + 1; } print_int(s); print_int(fact(5)); }"
+# arguments that are each other's registers, and more values across a call than callee-saved registers
+test "-44231312144" "int sub2(int a, int b) { return a - b; }
+int swap(int a, int b) { print_int(sub2(b, a)); return sub2(a, b); }
+int rot(int a, int b, int c) { return a * 100 + b * 10 + c; }
+int rot3(int a, int b, int c) { print_int(rot(b, c, a)); return rot(c, a, b); }
+int many(int x) { int a; int b; int c; int d; int e; int g; int h; int i;
+  a = x + 1; b = x + 2; c = x + 3; d = x + 4; e = x + 5; g = x + 6; h = x + 7; i = x + 8;
+  print_int(x);
+  return a + b + c + d + e + g + h + i; }
+int main() { print_int(swap(7, 3)); print_int(rot3(1, 2, 3)); print_int(many(1)); }"
+# deep enough to overflow the stack without tail calls
+test_with_flags "-O1" "178429366421" "int sum(int n, int acc) { if(n == 0) return acc; return sum(n - 1, acc + n); }
+int gcd(int a, int b) { if(b == 0) { return a; } return gcd(b, a - b * (a / b)); }
+int main() { print_int(sum(1000000, 0)); print_int(gcd(1071, 462)); }"
+test_with_flags "-O1" "11" "int even(int n) { if(n == 0) return 1; return odd(n - 1); }
+int odd(int n) { if(n == 0) return 0; return even(n - 1); }
+int main() { print_int(even(1000000)); print_int(odd(7)); }"
+test_with_flags "-fomit-frame-pointer" "55" "int fib(int n) { if(n == 0) return 0; if(n == 1) return 1; return fib(n - 1) + fib(n - 2); }
+int main() { print_int(fib(10)); }"
+test_with_flags "-fomit-frame-pointer" "0531" "int f(int x) { int a; int b; int c; int d; int e; int g; int h; int i; int j; int s;
+  a = x + 1; b = x + 2; c = x + 3; d = x + 4; e = x + 5; g = x + 6; h = x + 7; i = x + 8; j = x + 9;
+  s = a + b + c + d + e + g + h + i + j; print_int(0 - 0);
+  a = s + 1; b = s + 2; c = s + 3; d = s + 4; e = s + 5; g = s + 6; h = s + 7; i = s + 8; j = s + 9;
+  return a + b + c + d + e + g + h + i + j; }
+int main() { print_int(f(1)); }"
+test_asm_with_flags "-O1" ".text .global f f: movl %edi, %ecx addl \$1, %ecx movl %ecx, %eax ret " "int f(int a) { return a + 1; }"
+test_asm_with_flags "-O0" ".text .global f f: movl %edi, %ecx movl \$1, %esi addl %esi, %ecx movl %ecx, %eax ret " "int f(int a) { return a + 1; }"
+test_with_flags "-O1" "615" "int f(int x) { int a; int b; int c; int d; int e; int g; int h; int i; int j; int k; int l; int m; int n; int o;
+  a = x + 1; b = x + 2; c = x + 3; d = x + 4; e = x + 5; g = x + 6; h = x + 7; i = x + 8; j = x + 9; k = x * 3; l = x * 5; m = x * 7; n = x * 9; o = x * 11;
+  return a * b + c * d + e * g + h * i + j * k + l * m + n * o + a * o + b * n + c * m + d * l + e * k + g * j + h * i + g * g; }
+int main() { print_int(f(1)); }"
+# walking the unfolded Ast gives what the compiled code does
+test_with_flags "-e" "-3-21474836483-14" "int main() { int a; a = 0 - 7; print_int(a / 2); print_int(2147483647 + 1); { int b; b = 3; print_int(b); }
+  if(a == 7) print_int(1); else { print_int(mul(a, 2)); } }"
+test_with_flags "-e" "1784293664121" "int sum(int n, int acc) { if(n == 0) return acc; return sum(n - 1, acc + n); }
+int fib(int n) { if(n == 0) return 0; if(n == 1) return 1; return fib(n - 1) + fib(n - 2); }
+int main() { print_int(sum(1000000, 0)); print_int(fib(1)); print_int(add6(1, 2, 3, 4, 5, 6)); }"
+# calls that aren't tail ones don't recurse in C either
+test_with_flags "-e" "300000" "int d(int n) { if(n == 0) return 0; return 1 + d(n - 1); }
+int main() { print_int(d(300000)); }"
+test_with_flags "-O1 -b" "-3-1-56-21474836481784293664075025" "int sum(int n, int acc) { if(n == 0) return acc; return sum(n - 1, acc + n); }
+int even(int n) { if(n == 0) return 1; return odd(n - 1); }
+int odd(int n) { if(n == 0) return 0; return even(n - 1); }
+int fib(int n) { if(n == 0) return 0; if(n == 1) return 1; return fib(n - 1) + fib(n - 2); }
+int main() { int a; a = 0 - 7; print_int(a / 2); print_int(a / 4); print_int(a * 8); print_int(2147483647 + 1);
+  print_int(sum(1000000, 0)); print_int(even(1000001)); print_int(fib(25)); }"
+# a host function called with the wrong number of args is rejected, not run
+test_trap_with_flags "-r" "int main() { add(1); return 0; }"
+test_trap_with_flags "-O2 -r" "int main() { add(1); return 0; }"
+test_trap_with_flags "-e" "int main() { add(1); return 0; }"
+test_trap_with_flags "-O1 -b" "int main() { add(1); return 0; }"